@@ -0,0 +1,209 @@
+#ifndef TURBOEVENTS_SHM_HPP
+#define TURBOEVENTS_SHM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/***********************************************************************
+ * Layout of the shared-memory ring written by SharedMemoryOutput and a
+ * small header-only reader for consumers on the same host.
+ *
+ * The ring is a POSIX shared memory object consisting of a RingHeader
+ * followed by slotCount slots of slotStride bytes each. There is a
+ * single producer and any number of consumers. Consumers only write to
+ * the header, to count themselves while attached, so they cannot stall
+ * the producer; a producer may be asked to wait for them to attach
+ * before it publishes and to detach after it closes the ring.
+ *
+ * Event n (counting from 0) is stored in slot n % slotCount. Each slot
+ * is guarded by a sequence lock: while the producer writes event n the
+ * slot sequence number is 2n + 1, and when the event is published it
+ * is 2n + 2. A consumer that falls more than slotCount events behind
+ * the producer, or that sees the sequence number change while it reads
+ * a slot, has been overrun and skips forward to the oldest event still
+ * in the ring, counting the events it lost.
+ * *********************************************************************/
+
+namespace TurboEvents::Shm {
+
+/// Magic number identifying a turbo-events ring ("TERING01").
+inline constexpr uint64_t ringMagic = 0x544552494e473031;
+/// Version of the ring layout.
+inline constexpr uint32_t ringVersion = 2;
+/// Slot flag set when the payload did not fit in the slot.
+inline constexpr uint32_t slotTruncated = 1;
+
+/// Header at the start of the shared memory object.
+struct RingHeader {
+  /// Always ringMagic once initialized, published last.
+  std::atomic<uint64_t> magic;
+  uint32_t version;    ///< Always ringVersion.
+  uint32_t slotSize;   ///< Maximum payload size of a slot.
+  uint64_t slotCount;  ///< Number of slots, a power of two.
+  uint64_t slotStride; ///< Distance in bytes between slots.
+  /// Number of events published so far.
+  alignas(64) std::atomic<uint64_t> head;
+  /// Non-zero when the producer has finished.
+  alignas(64) std::atomic<uint32_t> closed;
+  /// Number of readers attached to the ring.
+  alignas(64) std::atomic<uint32_t> readers;
+};
+
+/// Header of each slot, followed by slotSize bytes of payload.
+struct SlotHeader {
+  std::atomic<uint64_t> seq; ///< Sequence lock, see above.
+  int64_t time;              ///< Event time in nanoseconds since the epoch.
+  uint32_t size;             ///< Number of payload bytes stored.
+  uint32_t flags;            ///< Bit set of slot flags.
+};
+
+/// Offset of the first slot from the start of the ring.
+inline constexpr uint64_t headerBytes =
+    (sizeof(RingHeader) + 63) & ~uint64_t(63);
+
+/// Distance between slots with a given payload size.
+inline constexpr uint64_t slotStride(uint32_t slotSize) {
+  return (sizeof(SlotHeader) + slotSize + 63) & ~uint64_t(63);
+}
+
+/// Total size of a ring with the given geometry.
+inline constexpr uint64_t ringBytes(uint64_t slotCount, uint32_t slotSize) {
+  return headerBytes + slotCount * slotStride(slotSize);
+}
+
+/// Address of the slot holding event n.
+inline SlotHeader *slotFor(RingHeader *h, uint64_t n) {
+  return reinterpret_cast<SlotHeader *>(reinterpret_cast<char *>(h) +
+                                        headerBytes +
+                                        (n & (h->slotCount - 1)) *
+                                            h->slotStride);
+}
+
+/// Payload bytes of a slot.
+inline char *slotData(SlotHeader *s) {
+  return reinterpret_cast<char *>(s) + sizeof(SlotHeader);
+}
+
+/// An event read from the ring.
+struct Message {
+  uint64_t seq;          ///< Sequence number of the event.
+  int64_t time;          ///< Event time in nanoseconds since the epoch.
+  std::string_view data; ///< Payload, points into the shared memory.
+  bool truncated;        ///< Whether the payload was cut at slotSize.
+};
+
+/// A consumer of a shared-memory ring.
+class RingReader {
+public:
+  /// Result of polling the ring.
+  enum class Status { Ok, Empty, Overrun, Closed };
+
+  /// Constructor, check attached() before use.
+  explicit RingReader(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 &&
+        static_cast<size_t>(st.st_size) >= sizeof(RingHeader)) {
+      void *p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+      if (p != MAP_FAILED) {
+        hdr = static_cast<RingHeader *>(p);
+        bytes = st.st_size;
+        if (hdr->magic.load(std::memory_order_acquire) != ringMagic ||
+            hdr->version != ringVersion ||
+            bytes < ringBytes(hdr->slotCount, hdr->slotSize)) {
+          munmap(p, bytes);
+          hdr = nullptr;
+        }
+      }
+    }
+    close(fd);
+    if (!hdr) return;
+    hdr->readers.fetch_add(1, std::memory_order_acq_rel);
+    // Start with the oldest event still in the ring.
+    next = oldest(hdr->head.load(std::memory_order_acquire));
+  }
+  RingReader(const RingReader &) = delete;
+  RingReader &operator=(const RingReader &) = delete;
+  /// Destructor, detach from the ring.
+  ~RingReader() {
+    if (!hdr) return;
+    hdr->readers.fetch_sub(1, std::memory_order_acq_rel);
+    munmap(hdr, bytes);
+  }
+
+  /// Whether the ring was successfully mapped.
+  bool attached() const { return hdr != nullptr; }
+
+  /// Fetch the next event without copying.
+  ///
+  /// The payload in m.data may be overwritten by the producer at any
+  /// time, call valid(m) after consuming it to make sure it was intact.
+  Status poll(Message &m) {
+    uint64_t h = hdr->head.load(std::memory_order_acquire);
+    if (next >= h)
+      return hdr->closed.load(std::memory_order_acquire) ? Status::Closed
+                                                         : Status::Empty;
+    if (h - next > hdr->slotCount) return skip(h);
+    SlotHeader *s = slotFor(hdr, next);
+    const uint64_t expected = 2 * next + 2;
+    if (s->seq.load(std::memory_order_acquire) != expected) return skip(h);
+    m.seq = next;
+    m.time = s->time;
+    m.data = std::string_view(slotData(s),
+                              std::min(s->size, hdr->slotSize));
+    m.truncated = s->flags & slotTruncated;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s->seq.load(std::memory_order_relaxed) != expected) return skip(h);
+    ++next;
+    return Status::Ok;
+  }
+
+  /// Check that the payload of a polled message was not overwritten.
+  bool valid(const Message &m) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slotFor(hdr, m.seq)->seq.load(std::memory_order_relaxed) ==
+           2 * m.seq + 2;
+  }
+
+  /// Number of events lost because this reader was too slow.
+  uint64_t lost() const { return lostEvents; }
+
+private:
+  /// The oldest event in the ring given the producer head.
+  uint64_t oldest(uint64_t h) const {
+    return h > hdr->slotCount ? h - hdr->slotCount : 0;
+  }
+  /// Recover from an overrun by skipping to the oldest available event.
+  Status skip(uint64_t h) {
+    h = std::max(h, hdr->head.load(std::memory_order_acquire));
+    // Leave one slot of slack since the producer may be writing it.
+    uint64_t n = oldest(h) + (h >= hdr->slotCount ? 1 : 0);
+    if (n > next) {
+      lostEvents += n - next;
+      next = n;
+    } else {
+      lostEvents += 1;
+      next += 1;
+    }
+    return Status::Overrun;
+  }
+
+  RingHeader *hdr = nullptr; ///< The mapped ring, if any.
+  size_t bytes = 0;          ///< Size of the mapping.
+  uint64_t next = 0;         ///< Sequence number of the next event to read.
+  uint64_t lostEvents = 0;   ///< Events skipped due to overruns.
+};
+
+} // namespace TurboEvents::Shm
+
+#endif
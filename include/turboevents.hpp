@@ -1,13 +1,21 @@
 #ifndef TURBOEVENTS_HPP
 #define TURBOEVENTS_HPP
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace TurboEvents {
 
+/// Number of heap allocations so far, for the measurements of a run. It
+/// stays 0 unless the program replaces the global operator new to count
+/// them, as the turboevents binary does.
+extern std::atomic<uint64_t> allocationCount;
+
 /// A class encapsulating an event generator
 class TurboEvents {
 public:
@@ -23,29 +31,82 @@ public:
   virtual void createContainerInput() = 0;
   /// Create a new StreamInput object.
   virtual void createCountDownInput(int m, int i = 200) = 0;
+  /// Create a new CSV file input.
+  virtual void createCSVFileInput(const char *name, char delim, int tsCol,
+                                  std::string tsFmt, int keyCol,
+                                  bool header) = 0;
   /// Create a new XML file input.
   virtual void
   createXMLFileInput(const char *name,
                      std::vector<std::vector<std::string>> &ctrl) = 0;
+  /// Present count copies of each stream of the most recently created
+  /// input, with field idField of the payloads suffixed by "_<copy>" in
+  /// copies from 1 on, unless idField is -1. Copy i is moved in time by
+  /// i * offsetSeconds plus a random jitter of up to jitterSeconds.
+  virtual void setReplicas(int count, int idField, double offsetSeconds,
+                           double jitterSeconds) = 0;
 
   /// Add a Kafka output.
   virtual void addKafkaOutput(std::string brokers, std::string caLocation,
                               std::string certLocation, std::string keyLocation,
                               std::string keyPwd, std::string topic) = 0;
+  /// Add an output writing one event per line to a file.
+  virtual void addFileOutput(std::string name) = 0;
   /// Add a print output.
   virtual void addPrintOutput() = 0;
+  /// Add a shared-memory ring output. If readers is not 0, wait for that
+  /// many readers to attach before the run and for them to detach after.
+  virtual void addSharedMemoryOutput(std::string name, uint64_t slots,
+                                     uint32_t slotSize, uint32_t readers) = 0;
+  /// Add an operator, such as "sample:0.1", to the pipeline of the most
+  /// recently added output.
+  virtual void addOperator(std::string spec) = 0;
 
   /// Run the file in Python.
   static void runScript(std::string &file);
   /// Run the string in Python.
   static void runString(std::string &s);
 
+  /// Replay the inputs count times, 0 for no end, with each pass moved
+  /// by the span of the first plus gapSeconds.
+  virtual void setLoop(int count, double gapSeconds) = 0;
+
+  /// Pace the run as if no gap between consecutive events were longer
+  /// than seconds, 0 for no limit. Time stamps are left as they are.
+  virtual void setMaxGap(double seconds) = 0;
+
   /// Run the event generator and process events.
   virtual void run(double scale) = 0;
+  /// Emit only a partition of the streams, coordinating the start time
+  /// with the other processes through a shared directory. The processes
+  /// of a run share a run id that differs from that of earlier runs.
+  virtual void setPartition(int rank, int count, std::string dir,
+                            std::string runId) = 0;
+  /// Record a Chrome trace of the run, if built with tracing.
+  virtual void setTraceFile(std::string file) = 0;
+  /// Write load time, throughput, lateness, allocations and peak memory of
+  /// the run as JSON to file, "-" for standard error.
+  virtual void setStatsFile(std::string file) = 0;
+  /// Pace the run by a profile of (seconds, events per second) points
+  /// instead of the event time stamps.
+  virtual void
+  setRateProfile(std::vector<std::pair<double, double>> profile) = 0;
 
   /// Add an event to an internal container.
   virtual void addEvent(std::chrono::system_clock::time_point time,
                         std::string data) = 0;
+
+  /// Make run() merge events injected while it runs without waiting
+  /// more than a millisecond for them, and also receive them one per
+  /// line on a Unix domain socket unless socketPath is empty. A line
+  /// "@<ms since epoch> <payload>" is emitted at that wall-clock time,
+  /// whatever the pacing, other lines as soon as possible.
+  virtual void enableInjection(std::string socketPath) = 0;
+  /// Inject an event into the run, from any thread. The event is merged
+  /// with the streams by time; events for after the end of the run are
+  /// dropped.
+  virtual void injectEvent(std::chrono::system_clock::time_point time,
+                           std::string data) = 0;
 };
 
 } // namespace TurboEvents
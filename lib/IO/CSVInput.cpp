@@ -0,0 +1,238 @@
+#include "CSVInput.hpp"
+#include "Decompressor.hpp"
+#include "Trace.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace TurboEvents {
+
+/***********************************************************************
+ * Scanning for separators.
+ *
+ * Rows are found by looking for the first of two bytes, the field
+ * delimiter and the newline, 32 (AVX2) or 16 (SSE2) bytes at a time.
+ * The vector width is chosen at compile time, configure with
+ * -DNATIVE=ON to build for the instruction set of the host. The
+ * scalar loop handles the tail of the file and other architectures.
+ *
+ * Quoted fields are not supported, a delimiter or newline always ends
+ * a field.
+ * *********************************************************************/
+
+/// Return the first occurrence of a or b in [p, end), or end.
+static const char *findEither(const char *p, const char *end, char a, char b) {
+#if defined(__AVX2__)
+  const __m256i va = _mm256_set1_epi8(a);
+  const __m256i vb = _mm256_set1_epi8(b);
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#elif defined(__SSE2__)
+  const __m128i va = _mm_set1_epi8(a);
+  const __m128i vb = _mm_set1_epi8(b);
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#endif
+  for (; p < end; ++p)
+    if (*p == a || *p == b) return p;
+  return end;
+}
+
+/// Return the first newline in [p, end), or end.
+static const char *findNewline(const char *p, const char *end) {
+  return findEither(p, end, '\n', '\n');
+}
+
+/// Return the end of the contents of the row from row to the newline eol,
+/// leaving out the carriage return of DOS line endings.
+static const char *trimCR(const char *row, const char *eol) {
+  return eol > row && eol[-1] == '\r' ? eol - 1 : eol;
+}
+
+CSVFileInput::~CSVFileInput() { finish(); }
+
+const char *CSVFileInput::rowEnd(uint64_t off) const {
+  return trimCR(data + off, findNewline(data + off, data + size));
+}
+
+std::string_view CSVFileInput::field(const char *row, const char *end,
+                                     int col) const {
+  for (int i = 0; i < col; ++i) {
+    row = findEither(row, end, delimiter, '\n');
+    if (row == end) return std::string_view();
+    ++row;
+  }
+  return std::string_view(row, findEither(row, end, delimiter, '\n') - row);
+}
+
+std::chrono::system_clock::time_point
+CSVFileInput::parseTime(std::string_view ts) const {
+  if (tsFormat == "ms") {
+    // Empty for a missing column, and the time in nanoseconds must fit.
+    uint64_t ms;
+    auto [end, ec] = std::from_chars(ts.data(), ts.data() + ts.size(), ms);
+    if (ts.empty() || ec != std::errc() || end != ts.data() + ts.size() ||
+        ms > uint64_t(std::numeric_limits<int64_t>::max() / 1000000)) {
+      std::cerr << "Could not parse time: '" << ts << "'\n";
+      exit(1);
+    }
+    return std::chrono::system_clock::time_point(
+        std::chrono::milliseconds(ms));
+  }
+
+  // strptime() needs a terminated string, time stamps are short.
+  char buf[64];
+  size_t n = std::min(ts.size(), sizeof(buf) - 1);
+  std::memcpy(buf, ts.data(), n);
+  buf[n] = '\0';
+  struct tm timeBuf = {};
+  if (!strptime(buf, tsFormat.c_str(), &timeBuf)) {
+    std::cerr << "Could not parse time: '" << ts << "'\n";
+    exit(1);
+  }
+  return std::chrono::system_clock::from_time_t(std::mktime(&timeBuf));
+}
+
+std::string
+CSVFileInput::formatTime(std::chrono::system_clock::time_point tp) const {
+  if (tsFormat == "ms")
+    return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                              tp.time_since_epoch())
+                              .count());
+
+  std::time_t tptime = std::chrono::system_clock::to_time_t(tp);
+  char buf[100];
+  // See XMLInput.cpp on the use of std::localtime.
+  size_t n = std::strftime(buf, sizeof(buf), tsFormat.c_str(),
+                           std::localtime(&tptime));
+  return std::string(buf, n);
+}
+
+void CSVFileInput::load() {
+  if (DecompressingReader::isCompressed(fname)) {
+    DecompressingReader reader(fname);
+    char buf[64 * 1024];
+    for (size_t n; (n = reader.read(buf, sizeof(buf))) > 0;)
+      inflated.append(buf, n);
+    data = inflated.data();
+    size = inflated.size();
+    return;
+  }
+
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Failed to open " << fname << ": " << strerror(errno) << "\n";
+    exit(1);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    std::cerr << "Failed to stat " << fname << ": " << strerror(errno) << "\n";
+    exit(1);
+  }
+  size = st.st_size;
+  if (size > 0) {
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      std::cerr << "Failed to map " << fname << ": " << strerror(errno)
+                << "\n";
+      exit(1);
+    }
+    data = static_cast<const char *>(p);
+    mapped = true;
+  }
+  close(fd);
+}
+
+void CSVFileInput::addStreams(Config &cfg,
+                              std::function<void(EventStream *)> push) {
+  TE_TRACE_SCOPE(csv_load);
+  load();
+
+  // Index the rows of the file, splitting them by key.
+  const char *p = data;
+  const char *const end = data + size;
+  if (skipHeader && p) p = std::min(findNewline(p, end) + 1, end);
+  bool firstEvent = true;
+  std::chrono::nanoseconds shift(0);
+  std::unordered_map<std::string_view, CSVStream *> byKey;
+  for (; p < end;) {
+    const char *eol = findNewline(p, end);
+    // The last field must not include the '\r' of a DOS line ending.
+    const char *last = trimCR(p, eol);
+    if (last == p) { // Skip empty rows.
+      p = eol + 1;
+      continue;
+    }
+    if (firstEvent) {
+      auto tp = parseTime(field(p, last, tsColumn));
+      if (cfg.tshift) shift = cfg.start - tp;
+      firstEvent = false;
+    }
+    std::string_view key;
+    if (keyColumn >= 0) key = field(p, last, keyColumn);
+    CSVStream *&s = byKey[key];
+    if (!s) {
+      streams.push_back(std::make_unique<CSVStream>(*this, delimiter, shift));
+      s = streams.back().get();
+    }
+    s->rows->push_back(p - data);
+    p = eol + 1;
+  }
+
+  // From now on the rows are read stream by stream, not in file order.
+  if (mapped) madvise(const_cast<char *>(data), size, MADV_RANDOM);
+  for (auto &s : streams) push(s.get());
+}
+
+void CSVFileInput::finish() {
+  if (mapped) munmap(const_cast<char *>(data), size);
+  mapped = false;
+  data = nullptr;
+  inflated = std::string();
+}
+
+bool CSVStream::generate(Config &cfg) {
+  // FIXME: (Clang-13) Use std::ssize(*rows) in RHS instead casting LHS.
+  if (static_cast<size_t>(++ix) >= rows->size()) return false;
+
+  const uint64_t off = (*rows)[ix];
+  const char *row = input.data + off;
+  const char *end = input.rowEnd(off);
+  std::string_view ts = input.field(row, end, input.tsColumn);
+  auto tp = input.parseTime(ts) + shift + offset;
+  time = tp;
+
+  if ((shift + offset).count() == 0) {
+    event = cfg.makeDelimitedEvent(tp, std::string(row, end));
+  } else {
+    // Replace the time stamp field with the shifted time.
+    std::string csv(row, ts.data());
+    csv += input.formatTime(tp);
+    csv.append(ts.data() + ts.size(), end);
+    event = cfg.makeDelimitedEvent(tp, std::move(csv));
+  }
+  return true;
+}
+
+} // namespace TurboEvents
@@ -0,0 +1,112 @@
+#ifndef CSVINPUT_HPP
+#define CSVINPUT_HPP
+
+#include "turboevents-internal.hpp"
+
+#include <string>
+#include <vector>
+
+namespace TurboEvents {
+
+class CSVFileInput;
+
+/// Event stream of the rows in a CSV file that share a key.
+class CSVStream : public EventStream {
+public:
+  /// Constructor, the fields of the rows are separated by delim.
+  CSVStream(const CSVFileInput &in, char delim, std::chrono::nanoseconds s)
+      : EventStream(delim), rows(std::make_shared<std::vector<uint64_t>>()),
+        input(in), shift(s), offset(0), ix(-1) {}
+  virtual ~CSVStream() {}
+
+  Event *getEvent() const override { return event.get(); }
+
+  bool generate(Config &cfg) override;
+
+  bool rewind(std::chrono::nanoseconds off) override {
+    ix = -1;
+    offset = off;
+    return true;
+  }
+
+  std::unique_ptr<EventStream>
+  replicate(std::chrono::nanoseconds off) override {
+    auto s = std::make_unique<CSVStream>(input, sep, shift + off);
+    s->rows = rows;
+    return s;
+  }
+
+  /// Byte offsets of the rows of the stream in the file, shared with
+  /// the replicas of the stream.
+  std::shared_ptr<std::vector<uint64_t>> rows;
+
+private:
+  const CSVFileInput &input;       ///< The input owning the file mapping.
+  std::chrono::nanoseconds shift;  ///< Time shift applied to all rows.
+  std::chrono::nanoseconds offset; ///< Offset of the current pass.
+  ssize_t ix;                      ///< Index of current row.
+  std::unique_ptr<Event> event;    ///< The current event.
+};
+
+/// An input class encapsulating a memory mapped CSV or TSV file.
+///
+/// The file is scanned once when the streams are added to find the
+/// start of each row and the key of the stream it belongs to. Events
+/// are then made lazily, one row at a time, as the streams advance.
+/// Compressed files are decompressed into memory instead of mapped.
+class CSVFileInput : public Input {
+public:
+  /// Constructor
+  CSVFileInput(const char *fileName, char delim, int tsCol,
+               std::string tsFmt, int keyCol, bool header)
+      : fname(fileName), delimiter(delim), tsColumn(tsCol),
+        tsFormat(std::move(tsFmt)), keyColumn(keyCol), skipHeader(header),
+        data(nullptr), size(0), mapped(false) {}
+  virtual ~CSVFileInput();
+
+  void addStreams(Config &cfg,
+                  std::function<void(EventStream *)> push) override;
+
+  void finish() override;
+
+private:
+  friend class CSVStream;
+
+  /// Make the contents of the file available in data.
+  void load();
+
+  /// Return the end of the row starting at offset off.
+  const char *rowEnd(uint64_t off) const;
+  /// Return the field with index col of a row, or an empty view.
+  std::string_view field(const char *row, const char *end, int col) const;
+  /// Parse a time stamp according to tsFormat.
+  std::chrono::system_clock::time_point parseTime(std::string_view ts) const;
+  /// Render a time stamp according to tsFormat.
+  std::string formatTime(std::chrono::system_clock::time_point tp) const;
+
+  /// The name of the file
+  std::string fname;
+  /// Field separator
+  char delimiter;
+  /// Index of the time stamp column
+  int tsColumn;
+  /// strptime() format of the time stamps, or "ms" for epoch milliseconds
+  std::string tsFormat;
+  /// Index of the column splitting the rows into streams, -1 for none
+  int keyColumn;
+  /// Whether the first row is a header
+  bool skipHeader;
+  /// The mapped file
+  const char *data;
+  /// Size of the mapped file
+  size_t size;
+  /// Whether data is a mapping of the file or points into inflated
+  bool mapped;
+  /// The contents of a compressed file after decompression
+  std::string inflated;
+  /// The streams of the file, in order of first appearance of their key.
+  std::vector<std::unique_ptr<CSVStream>> streams;
+};
+
+} // namespace TurboEvents
+#endif
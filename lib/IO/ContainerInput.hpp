@@ -6,33 +6,74 @@
 namespace TurboEvents {
 
 /// Event stream that generates events from a container.
+///
+/// The events may be shared with replicas of the stream, see replicate().
 class ContainerStream : public EventStream {
 public:
-  /// Constructor
-  ContainerStream(std::vector<std::unique_ptr<Event>> v)
-      : events(std::move(v)), ix(-1) {}
+  /// Function making a copy of an event moved in time by an offset.
+  using Retimer = std::function<std::unique_ptr<Event>(
+      const Event &, std::chrono::nanoseconds)>;
+  /// The events of a stream.
+  using Events = std::vector<std::unique_ptr<Event>>;
+
+  /// Constructor, retimer defaults to keeping the payload as it is.
+  ContainerStream(Events v, char s, Retimer r = nullptr)
+      : ContainerStream(std::make_shared<const Events>(std::move(v)), s,
+                        std::move(r), std::chrono::nanoseconds(0)) {}
   virtual ~ContainerStream() {}
 
-  Event *getEvent() const override { return events[ix].get(); }
+  Event *getEvent() const override {
+    return moved ? moved.get() : (*events)[ix].get();
+  }
 
   bool generate(Config &) override {
-    // FIXME: (Clang-13) Use std::ssize(events) in RHS instead casting LHS.
-    if (static_cast<size_t>(++ix) >= events.size()) return false;
-    time = events[ix]->time;
+    // FIXME: (Clang-13) Use std::ssize(*events) in RHS instead casting LHS.
+    if (static_cast<size_t>(++ix) >= events->size()) return false;
+    const Event &e = *(*events)[ix];
+    if (offset.count() == 0) {
+      time = e.time;
+      return true;
+    }
+    // Only events of later passes and replicas need a copy.
+    moved = retimer ? retimer(e, offset) : e.copyAt(e.time + offset);
+    time = moved->time;
+    return true;
+  }
+
+  bool rewind(std::chrono::nanoseconds off) override {
+    ix = -1;
+    offset = base + off;
+    moved.reset();
     return true;
   }
 
+  std::unique_ptr<EventStream>
+  replicate(std::chrono::nanoseconds off) override {
+    return std::unique_ptr<EventStream>(
+        new ContainerStream(events, sep, retimer, base + off));
+  }
+
 private:
-  std::vector<std::unique_ptr<Event>> events; ///< The events of the stream.
-  ssize_t ix;                                 ///< Index of current event.
+  /// Constructor for streams sharing events.
+  ContainerStream(std::shared_ptr<const Events> v, char s, Retimer r,
+                  std::chrono::nanoseconds b)
+      : EventStream(s), events(std::move(v)), retimer(std::move(r)), ix(-1),
+        base(b), offset(b) {}
+
+  std::shared_ptr<const Events> events; ///< The events of the stream.
+  Retimer retimer;                      ///< Makes moved copies of events.
+  ssize_t ix;                           ///< Index of current event.
+  const std::chrono::nanoseconds base;  ///< Offset of the stream.
+  std::chrono::nanoseconds offset;      ///< Offset of the current pass.
+  std::unique_ptr<Event> moved;         ///< The current event, if moved.
 };
 
 /// An input class for streams triggering events from an internal container.
 class ContainerInput : public Input {
 public:
-  /// Constructor
-  ContainerInput(std::vector<std::unique_ptr<Event>> v)
-      : stream(std::make_unique<ContainerStream>(std::move(v))) {}
+  /// Constructor, the fields of the events are separated by s.
+  ContainerInput(std::vector<std::unique_ptr<Event>> v, char s)
+      : stream(std::make_unique<ContainerStream>(std::move(v), s)) {}
 
   virtual ~ContainerInput() {}
 
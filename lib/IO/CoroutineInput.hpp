@@ -0,0 +1,190 @@
+#ifndef COROUTINEINPUT_HPP
+#define COROUTINEINPUT_HPP
+
+#include "turboevents-internal.hpp"
+
+#include <array>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <utility>
+
+namespace TurboEvents {
+
+/// Pool of coroutine frames.
+///
+/// Frames are rounded up to size classes of granule bytes and recycled
+/// through a free list per class, so streams that are created and ended
+/// repeatedly do not go through the general purpose allocator. Larger
+/// frames are allocated directly. Memory in the pool is never returned.
+class FramePool {
+public:
+  /// Allocate a frame of n bytes.
+  static void *allocate(size_t n) {
+    const size_t c = sizeClass(n);
+    if (c >= classes) return ::operator new(n);
+    if (Free *f = freeLists[c]) {
+      freeLists[c] = f->next;
+      return f;
+    }
+    return ::operator new((c + 1) * granule);
+  }
+
+  /// Return a frame of n bytes to the pool.
+  static void deallocate(void *p, size_t n) {
+    const size_t c = sizeClass(n);
+    if (c >= classes) {
+      ::operator delete(p);
+      return;
+    }
+    freeLists[c] = new (p) Free{freeLists[c]};
+  }
+
+private:
+  /// A frame in a free list.
+  struct Free {
+    Free *next; ///< The next free frame of the same class.
+  };
+
+  /// The size class of frames of n bytes.
+  static size_t sizeClass(size_t n) { return (n + granule - 1) / granule - 1; }
+
+  static constexpr size_t granule = 64; ///< Size class granularity.
+  static constexpr size_t classes = 16; ///< Number of size classes.
+  /// Free frames, per size class.
+  static inline thread_local std::array<Free *, classes> freeLists{};
+};
+
+/// A lazy sequence of events produced by a coroutine.
+///
+/// The coroutine yields tuples of a time and the fields of an event,
+/// which are serialized like the arguments of Config::makeEvent():
+///
+///   EventGenerator ticks(std::chrono::system_clock::time_point t) {
+///     for (int i = 0; i < 10; ++i)
+///       co_yield std::tuple(t += std::chrono::seconds(1), "tick", i);
+///   }
+///
+/// The coroutine only runs when next() is called, that is when its
+/// stream reaches the head of the merge in run(), so it holds no more
+/// than its current event in memory.
+class EventGenerator {
+public:
+  /// The promise of the coroutine. The names of the promise type and its
+  /// members are given by the coroutine protocol.
+  // NOLINTNEXTLINE(readability-identifier-naming)
+  struct promise_type {
+    /// Make the generator returned to the caller of the coroutine.
+    // NOLINTNEXTLINE(readability-identifier-naming)
+    EventGenerator get_return_object() {
+      return EventGenerator(Handle::from_promise(*this));
+    }
+    /// Do not start before the first event is asked for.
+    // NOLINTNEXTLINE(readability-identifier-naming)
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    /// Keep the frame until the generator is destroyed.
+    // NOLINTNEXTLINE(readability-identifier-naming)
+    std::suspend_always final_suspend() noexcept { return {}; }
+
+    /// Make the next event from a time and fields.
+    template <typename... Args>
+    std::suspend_always
+    // NOLINTNEXTLINE(readability-identifier-naming)
+    yield_value(std::tuple<std::chrono::system_clock::time_point, Args...> t) {
+      event = std::apply(
+          [this](auto tp, auto &&...args) {
+            return cfg->makeEvent(tp, std::forward<decltype(args)>(args)...);
+          },
+          std::move(t));
+      return {};
+    }
+
+    /// End of the sequence.
+    // NOLINTNEXTLINE(readability-identifier-naming)
+    void return_void() {}
+    /// Keep an exception to rethrow from next().
+    // NOLINTNEXTLINE(readability-identifier-naming)
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    /// Allocate the frame from the pool.
+    static void *operator new(size_t n) { return FramePool::allocate(n); }
+    /// Return the frame to the pool.
+    static void operator delete(void *p, size_t n) {
+      FramePool::deallocate(p, n);
+    }
+
+    /// The configuration to make events with.
+    Config *cfg = nullptr;
+    /// The current event.
+    std::unique_ptr<Event> event;
+    /// Exception thrown by the coroutine, if any.
+    std::exception_ptr exception;
+  };
+
+  /// Handle of the coroutine.
+  using Handle = std::coroutine_handle<promise_type>;
+
+  /// Move constructor
+  EventGenerator(EventGenerator &&o) noexcept
+      : handle(std::exchange(o.handle, nullptr)) {}
+  EventGenerator(const EventGenerator &) = delete;
+  EventGenerator &operator=(const EventGenerator &) = delete;
+  /// Destructor
+  ~EventGenerator() {
+    if (handle) handle.destroy();
+  }
+
+  /// Run the coroutine to its next event, return false at the end.
+  bool next(Config &cfg) {
+    if (!handle || handle.done()) return false;
+    handle.promise().cfg = &cfg;
+    handle.resume();
+    if (auto e = std::exchange(handle.promise().exception, nullptr))
+      std::rethrow_exception(e);
+    return !handle.done();
+  }
+
+  /// The current event.
+  Event *event() const { return handle.promise().event.get(); }
+
+private:
+  /// Constructor
+  explicit EventGenerator(Handle h) : handle(h) {}
+
+  Handle handle; ///< The coroutine.
+};
+
+/// Event stream delivering the events of a coroutine.
+///
+/// The coroutine is only created when the first event is asked for, so
+/// that it can depend on the configuration of the run, such as its
+/// start, while the stream gets its id when the input is created, like
+/// other streams.
+class CoroutineStream : public EventStream {
+public:
+  /// Function creating the coroutine.
+  using Factory = std::function<EventGenerator(Config &)>;
+
+  /// Constructor, the coroutine serializes events with separator s.
+  CoroutineStream(Factory f, char s) : EventStream(s), make(std::move(f)) {}
+  virtual ~CoroutineStream() {}
+
+  Event *getEvent() const override { return gen->event(); }
+
+  bool generate(Config &cfg) override {
+    if (!gen) gen.emplace(make(cfg));
+    if (!gen->next(cfg)) return false;
+    time = gen->event()->time;
+    return true;
+  }
+
+private:
+  Factory make;                      ///< Creates the coroutine.
+  std::optional<EventGenerator> gen; ///< The coroutine, once created.
+};
+
+} // namespace TurboEvents
+
+#endif
@@ -1,37 +1,21 @@
 #ifndef COUNTDOWNINPUT_HPP
 #define COUNTDOWNINPUT_HPP
 
-#include "turboevents-internal.hpp"
+#include "CoroutineInput.hpp"
 
 namespace TurboEvents {
 
-/// Event stream that counts down to 0.
-class CountDownEventStream : public EventStream {
-public:
-  /// Constructor
-  CountDownEventStream(int m, int i)
-      : n(m), interval(std::chrono::milliseconds(i)) {}
-
-  Event *getEvent() const override { return event.get(); }
-
-  bool generate(Config &cfg) override {
-    time += interval;
-    event = cfg.makeEvent(time, n, n + 1);
-    return n-- > 0;
-  }
-
-private:
-  int n;                                    ///< How many events to generate
-  const std::chrono::milliseconds interval; ///< Interval between events
-  std::unique_ptr<Event> event;             ///< The current event.
-};
-
 /// An input class for streams that count down.
 class CountDownInput : public Input {
 public:
-  /// Constructor
-  CountDownInput(int m, int i)
-      : stream(std::make_unique<CountDownEventStream>(m, i)) {}
+  /// Constructor, the fields of the events are separated by s.
+  CountDownInput(int m, int i, char s)
+      : stream(std::make_unique<CoroutineStream>(
+            [m, i](Config &cfg) {
+              // The start is only agreed on when the run begins.
+              return countDown(cfg.start, m, std::chrono::milliseconds(i));
+            },
+            s)) {}
 
   virtual ~CountDownInput() {}
 
@@ -42,6 +26,17 @@ public:
   void finish() override {}
 
 private:
+  /// Count down from n to 1, one event per interval after start. The
+  /// arguments are copied into the frame of the lazy coroutine.
+  static EventGenerator countDown(std::chrono::system_clock::time_point start,
+                                  int n, std::chrono::milliseconds interval) {
+    auto t = start;
+    for (; n > 0; --n) {
+      t += interval;
+      co_yield std::tuple(t, n, n + 1);
+    }
+  }
+
   /// The event stream
   std::unique_ptr<EventStream> stream;
 };
@@ -0,0 +1,155 @@
+#include "Decompressor.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <zlib.h>
+#ifdef TURBOEVENTS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace TurboEvents {
+
+static bool endsWith(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool DecompressingReader::isCompressed(const std::string &fileName) {
+  return endsWith(fileName, ".gz") || endsWith(fileName, ".zst");
+}
+
+DecompressingReader::DecompressingReader(std::string fileName,
+                                         size_t chunk, size_t chunks)
+    : fname(std::move(fileName)), chunkSize(chunk), maxChunks(chunks),
+      done(false), cancelled(false), offset(0), pos(0),
+      worker(&DecompressingReader::produce, this) {}
+
+DecompressingReader::~DecompressingReader() {
+  {
+    std::lock_guard<std::mutex> lock(m);
+    cancelled = true;
+  }
+  notFull.notify_all();
+  worker.join();
+}
+
+size_t DecompressingReader::read(char *buf, size_t n) {
+  if (offset == current.size()) {
+    std::unique_lock<std::mutex> lock(m);
+    notEmpty.wait(lock, [this] { return !chunks.empty() || done; });
+    if (chunks.empty()) {
+      if (!error.empty()) {
+        std::cerr << "Failed to decompress " << fname << ": " << error << "\n";
+        exit(1);
+      }
+      return 0;
+    }
+    current = std::move(chunks.front());
+    chunks.pop_front();
+    offset = 0;
+    lock.unlock();
+    notFull.notify_one();
+  }
+  n = std::min(n, current.size() - offset);
+  std::memcpy(buf, current.data() + offset, n);
+  offset += n;
+  pos += n;
+  return n;
+}
+
+bool DecompressingReader::push(std::string chunk) {
+  std::unique_lock<std::mutex> lock(m);
+  notFull.wait(lock, [this] { return chunks.size() < maxChunks || cancelled; });
+  if (cancelled) return false;
+  chunks.push_back(std::move(chunk));
+  lock.unlock();
+  notEmpty.notify_one();
+  return true;
+}
+
+void DecompressingReader::close(std::string err) {
+  {
+    std::lock_guard<std::mutex> lock(m);
+    done = true;
+    error = std::move(err);
+  }
+  notEmpty.notify_all();
+}
+
+void DecompressingReader::produce() {
+  if (endsWith(fname, ".zst"))
+    produceZstd();
+  else
+    produceGzip();
+}
+
+void DecompressingReader::produceGzip() {
+  gzFile f = gzopen(fname.c_str(), "rb");
+  if (!f) return close(strerror(errno));
+  gzbuffer(f, chunkSize);
+  std::string err;
+  for (;;) {
+    std::string chunk(chunkSize, '\0');
+    int n = gzread(f, chunk.data(), chunk.size());
+    if (n < 0) {
+      int errnum;
+      err = gzerror(f, &errnum);
+      break;
+    }
+    if (n == 0) break;
+    chunk.resize(n);
+    if (!push(std::move(chunk))) break;
+  }
+  gzclose(f);
+  close(err);
+}
+
+void DecompressingReader::produceZstd() {
+#ifdef TURBOEVENTS_HAVE_ZSTD
+  FILE *f = fopen(fname.c_str(), "rb");
+  if (!f) return close(strerror(errno));
+  ZSTD_DStream *ds = ZSTD_createDStream();
+  std::string in(ZSTD_DStreamInSize(), '\0');
+  std::string err;
+  size_t ret = 0;
+  bool stop = false;
+  while (!stop) {
+    size_t n = fread(in.data(), 1, in.size(), f);
+    if (n == 0) {
+      if (ferror(f)) err = strerror(errno);
+      // All output has been flushed below, so a frame that is still not
+      // finished cannot make progress and the file was truncated.
+      else if (ret != 0) err = "truncated file";
+      break;
+    }
+    ZSTD_inBuffer input = {in.data(), n, 0};
+    // A full output buffer may leave decoded data in the decoder, keep
+    // calling it until it does not fill the output, even when all the
+    // input has been consumed. A finished frame has been fully flushed.
+    for (bool full = true; input.pos < input.size || (full && ret != 0);) {
+      std::string chunk(chunkSize, '\0');
+      ZSTD_outBuffer output = {chunk.data(), chunk.size(), 0};
+      ret = ZSTD_decompressStream(ds, &output, &input);
+      if (ZSTD_isError(ret)) {
+        err = ZSTD_getErrorName(ret);
+        stop = true;
+        break;
+      }
+      full = output.pos == output.size;
+      chunk.resize(output.pos);
+      if (!chunk.empty() && !push(std::move(chunk))) {
+        stop = true;
+        break;
+      }
+    }
+  }
+  ZSTD_freeDStream(ds);
+  fclose(f);
+  close(err);
+#else
+  close("built without zstd support");
+#endif
+}
+
+} // namespace TurboEvents
@@ -0,0 +1,81 @@
+#ifndef DECOMPRESSOR_HPP
+#define DECOMPRESSOR_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace TurboEvents {
+
+/// Reader of a gzip or zstd compressed file.
+///
+/// The file is decompressed by a background thread into a bounded queue
+/// of chunks, so decompression overlaps with whatever consumes the data
+/// and no uncompressed copy of the file is ever written to disk.
+class DecompressingReader {
+public:
+  /// Constructor, starts the decompression thread.
+  DecompressingReader(std::string fileName, size_t chunkSize = 256 * 1024,
+                      size_t maxChunks = 8);
+  DecompressingReader(const DecompressingReader &) = delete;
+  DecompressingReader &operator=(const DecompressingReader &) = delete;
+  /// Destructor, stops the decompression thread.
+  ~DecompressingReader();
+
+  /// Read up to n bytes into buf, return 0 at the end of the file.
+  size_t read(char *buf, size_t n);
+  /// Number of bytes returned by read() so far.
+  uint64_t position() const { return pos; }
+
+  /// Whether the file name has the extension of a supported compression.
+  static bool isCompressed(const std::string &fileName);
+
+private:
+  /// Body of the decompression thread.
+  void produce();
+  /// Decompress a gzip file.
+  void produceGzip();
+  /// Decompress a zstd file.
+  void produceZstd();
+  /// Hand a chunk to the consumer, false if the reader is shutting down.
+  bool push(std::string chunk);
+  /// Note that decompression has finished, with an error if non-empty.
+  void close(std::string err);
+
+  /// Name of the compressed file.
+  std::string fname;
+  /// Size of the chunks handed to the consumer.
+  const size_t chunkSize;
+  /// Maximum number of chunks waiting for the consumer.
+  const size_t maxChunks;
+
+  /// Protects the fields below up to the decompression thread.
+  std::mutex m;
+  /// Signalled when a chunk has been consumed.
+  std::condition_variable notFull;
+  /// Signalled when a chunk has been produced or decompression ended.
+  std::condition_variable notEmpty;
+  /// Decompressed chunks waiting for the consumer.
+  std::deque<std::string> chunks;
+  /// Whether the decompression thread has finished.
+  bool done;
+  /// Whether the consumer has gone away.
+  bool cancelled;
+  /// Error message from the decompression thread.
+  std::string error;
+
+  /// The chunk currently being consumed.
+  std::string current;
+  /// Read position in the current chunk.
+  size_t offset;
+  /// Total number of bytes read.
+  uint64_t pos;
+  /// The decompression thread.
+  std::thread worker;
+};
+
+} // namespace TurboEvents
+#endif
@@ -0,0 +1,49 @@
+#ifndef FILEOUTPUT_HPP
+#define FILEOUTPUT_HPP
+
+#include "turboevents-internal.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace TurboEvents {
+
+/// Output object writing one event per line to a file.
+class FileOutput : public Output {
+public:
+  /// Constructor
+  FileOutput(const std::string &name) : fname(name) {
+    f = std::fopen(name.c_str(), "w");
+    if (!f) {
+      std::cerr << "Failed to open " << name << ": " << strerror(errno)
+                << "\n";
+      exit(1);
+    }
+    std::setvbuf(f, nullptr, _IOFBF, 1 << 20);
+  }
+  /// Destructor
+  virtual ~FileOutput() override {
+    if (std::fclose(f) != 0)
+      std::cerr << "Failed to write " << fname << ": " << strerror(errno)
+                << "\n";
+  }
+
+  /// Writes the data to the file.
+  void trigger(Event &e) override {
+    struct iovec iov[3];
+    for (int i = 0, n = e.gather(iov); i < n; ++i)
+      std::fwrite(iov[i].iov_base, 1, iov[i].iov_len, f);
+    std::fputc('\n', f);
+  }
+
+  void flush() override { std::fflush(f); }
+
+private:
+  std::string fname; ///< The name of the file.
+  std::FILE *f;      ///< The open file.
+};
+
+} // namespace TurboEvents
+#endif
@@ -20,30 +20,41 @@ KafkaOutput::KafkaOutput(std::string brokers, std::string caLoc,
   std::string errstr;
 
   RdKafka::Conf *c = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
-  if (c->set("bootstrap.servers", brokers, errstr) != RdKafka::Conf::CONF_OK) {
-    std::cerr << errstr << "\n";
-    exit(1);
-  }
-  if (c->set("security.protocol", "ssl", errstr) != RdKafka::Conf::CONF_OK) {
-    std::cerr << errstr << "\n";
-    exit(1);
-  }
-  if (c->set("ssl.ca.location", caLoc, errstr) != RdKafka::Conf::CONF_OK) {
-    std::cerr << errstr << "\n";
-    exit(1);
-  }
-  if (c->set("ssl.certificate.location", certLoc, errstr) !=
-      RdKafka::Conf::CONF_OK) {
-    std::cerr << errstr << "\n";
-    exit(1);
-  }
-  if (c->set("ssl.key.location", keyLoc, errstr) != RdKafka::Conf::CONF_OK) {
-    std::cerr << errstr << "\n";
-    exit(1);
-  }
-  if (c->set("ssl.key.password", keyPw, errstr) != RdKafka::Conf::CONF_OK) {
-    std::cerr << errstr << "\n";
-    exit(1);
+  if (brokers == "mock") {
+    // librdkafka's in-process mock cluster (librdkafka 1.3 or later), for
+    // testing without a broker.
+    if (c->set("test.mock.num.brokers", "1", errstr) !=
+        RdKafka::Conf::CONF_OK) {
+      std::cerr << errstr << "\n";
+      exit(1);
+    }
+  } else {
+    if (c->set("bootstrap.servers", brokers, errstr) !=
+        RdKafka::Conf::CONF_OK) {
+      std::cerr << errstr << "\n";
+      exit(1);
+    }
+    if (c->set("security.protocol", "ssl", errstr) != RdKafka::Conf::CONF_OK) {
+      std::cerr << errstr << "\n";
+      exit(1);
+    }
+    if (c->set("ssl.ca.location", caLoc, errstr) != RdKafka::Conf::CONF_OK) {
+      std::cerr << errstr << "\n";
+      exit(1);
+    }
+    if (c->set("ssl.certificate.location", certLoc, errstr) !=
+        RdKafka::Conf::CONF_OK) {
+      std::cerr << errstr << "\n";
+      exit(1);
+    }
+    if (c->set("ssl.key.location", keyLoc, errstr) != RdKafka::Conf::CONF_OK) {
+      std::cerr << errstr << "\n";
+      exit(1);
+    }
+    if (c->set("ssl.key.password", keyPw, errstr) != RdKafka::Conf::CONF_OK) {
+      std::cerr << errstr << "\n";
+      exit(1);
+    }
   }
 
   drCb = new DeliveryReportCb();
@@ -70,11 +81,17 @@ KafkaOutput::~KafkaOutput() {
 }
 
 void KafkaOutput::trigger(Event &e) {
+  // Kafka needs the payload in one piece, only assemble it when needed.
+  struct iovec iov[3];
+  if (e.gather(iov) > 1) {
+    e.assemble(buf);
+    iov[0] = {buf.data(), buf.size()};
+  }
 retry:
   RdKafka::ErrorCode err = p->produce(topic, RdKafka::Topic::PARTITION_UA,
                                       RdKafka::Producer::RK_MSG_COPY,
-                                      const_cast<char *>(e.data.c_str()),
-                                      e.data.size(), NULL, 0, 0, NULL, NULL);
+                                      iov[0].iov_base, iov[0].iov_len, NULL,
+                                      0, 0, NULL, NULL);
 
   if (err != RdKafka::ERR_NO_ERROR) {
     std::cerr << "% Failed to produce to topic " << topic << ": "
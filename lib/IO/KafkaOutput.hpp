@@ -27,6 +27,8 @@ private:
   DeliveryReportCb *drCb;
   /// The topic to send the data to.
   std::string topic;
+  /// Buffer for assembling payloads with a shared part.
+  std::string buf;
 };
 } // namespace TurboEvents
 #endif
@@ -16,7 +16,12 @@ public:
   virtual ~PrintOutput() override {}
 
   /// Prints the data to standard output.
-  void trigger(Event &e) override { std::cout << e.data << "\n"; }
+  void trigger(Event &e) override {
+    struct iovec iov[3];
+    for (int i = 0, n = e.gather(iov); i < n; ++i)
+      std::cout.write(static_cast<char *>(iov[i].iov_base), iov[i].iov_len);
+    std::cout << "\n";
+  }
 };
 
 } // namespace TurboEvents
@@ -0,0 +1,118 @@
+#ifndef REPLICATEDINPUT_HPP
+#define REPLICATEDINPUT_HPP
+
+#include "turboevents-internal.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace TurboEvents {
+
+/// Event stream presenting a replica of another stream under a new id.
+///
+/// The replica suffixes field idField of the payloads with "_<replica>"
+/// so that consumers see a distinct entity, or leaves the payloads as
+/// they are if idField is negative.
+class ReplicaStream : public EventStream {
+public:
+  /// Constructor
+  ReplicaStream(std::unique_ptr<EventStream> s, int field, int replica)
+      : EventStream(s->sep), inner(std::move(s)), idField(field),
+        suffix("_" + std::to_string(replica)) {}
+  virtual ~ReplicaStream() {}
+
+  Event *getEvent() const override {
+    return event ? event.get() : inner->getEvent();
+  }
+
+  bool generate(Config &cfg) override {
+    if (!inner->generate(cfg)) return false;
+    time = inner->time;
+    if (idField < 0) return true;
+
+    // Find the end of the id field and insert the suffix there. The
+    // fields are separated as in the input the stream comes from.
+    const Event *e = inner->getEvent();
+    e->assemble(buf);
+    size_t pos = 0;
+    for (int i = 0; i < idField && pos != std::string::npos; ++i) {
+      pos = buf.find(sep, pos);
+      if (pos != std::string::npos) ++pos;
+    }
+    if (pos != std::string::npos)
+      buf.insert(std::min(buf.find(sep, pos), buf.size()), suffix);
+    event = std::make_unique<Event>(e->time, buf);
+    return true;
+  }
+
+  bool rewind(std::chrono::nanoseconds off) override {
+    return inner->rewind(off);
+  }
+
+private:
+  std::unique_ptr<EventStream> inner; ///< The stream replicated.
+  const int idField;                  ///< Index of the id field, or -1.
+  const std::string suffix;           ///< Suffix of the id field.
+  std::unique_ptr<Event> event;       ///< The current event, if rewritten.
+  std::string buf;                    ///< Buffer for the payload.
+};
+
+/// An input presenting count copies of each stream of another input.
+///
+/// Copy 0 is the original stream. The others share the events of the
+/// original and are moved in time by their replica number times offset,
+/// plus a random jitter of up to jitter that is drawn per stream from a
+/// fixed seed, so runs are repeatable.
+class ReplicatedInput : public Input {
+public:
+  /// Constructor
+  ReplicatedInput(std::unique_ptr<Input> in, int c, int field,
+                  std::chrono::nanoseconds off, std::chrono::nanoseconds jit)
+      : input(std::move(in)), count(c), idField(field), offset(off),
+        jitter(jit) {}
+  virtual ~ReplicatedInput() {}
+
+  void addStreams(Config &cfg,
+                  std::function<void(EventStream *)> push) override {
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<int64_t> dist(
+        0, std::max<int64_t>(jitter.count() - 1, 0));
+    bool warned = false;
+    input->addStreams(cfg, [&](EventStream *s) {
+      std::vector<std::unique_ptr<EventStream>> copies;
+      for (int r = 1; r < count; ++r) {
+        auto copy = s->replicate(r * offset +
+                                 std::chrono::nanoseconds(dist(rng)));
+        if (!copy) {
+          if (!warned)
+            std::cerr << "Warning: input does not support replicas\n";
+          warned = true;
+          break;
+        }
+        copies.push_back(
+            std::make_unique<ReplicaStream>(std::move(copy), idField, r));
+      }
+      push(s);
+      for (auto &c : copies) {
+        replicas.push_back(std::move(c));
+        push(replicas.back().get());
+      }
+    });
+  }
+
+  void finish() override { input->finish(); }
+
+private:
+  std::unique_ptr<Input> input;          ///< The replicated input.
+  const int count;                       ///< Number of copies.
+  const int idField;                     ///< Index of the id field, or -1.
+  const std::chrono::nanoseconds offset; ///< Offset per replica.
+  const std::chrono::nanoseconds jitter; ///< Maximum jitter.
+  /// The replicas of the streams, excluding the originals.
+  std::vector<std::unique_ptr<EventStream>> replicas;
+};
+
+} // namespace TurboEvents
+
+#endif
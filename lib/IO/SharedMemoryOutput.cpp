@@ -0,0 +1,95 @@
+#include "SharedMemoryOutput.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace TurboEvents {
+
+SharedMemoryOutput::SharedMemoryOutput(std::string name, uint64_t slots,
+                                       uint32_t slotSize, uint32_t r)
+    : shmName(name), ring(nullptr), bytes(0), seq(0), readers(r) {
+  if (slots == 0 || (slots & (slots - 1)) != 0) {
+    std::cerr << "Shared memory slot count must be a power of two\n";
+    exit(1);
+  }
+
+  // Always start from a fresh object so that stale readers detach.
+  shm_unlink(shmName.c_str());
+  int fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    std::cerr << "Failed to create shared memory " << shmName << ": "
+              << strerror(errno) << "\n";
+    exit(1);
+  }
+  bytes = Shm::ringBytes(slots, slotSize);
+  if (ftruncate(fd, bytes) != 0) {
+    std::cerr << "Failed to size shared memory " << shmName << ": "
+              << strerror(errno) << "\n";
+    exit(1);
+  }
+  void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    std::cerr << "Failed to map shared memory " << shmName << ": "
+              << strerror(errno) << "\n";
+    exit(1);
+  }
+
+  // ftruncate() zero fills, so the atomics and slot sequence numbers
+  // start out as 0. Publish the magic number last.
+  ring = static_cast<Shm::RingHeader *>(p);
+  ring->version = Shm::ringVersion;
+  ring->slotSize = slotSize;
+  ring->slotCount = slots;
+  ring->slotStride = Shm::slotStride(slotSize);
+  ring->magic.store(Shm::ringMagic, std::memory_order_release);
+
+  auto deadline = std::chrono::steady_clock::now() + readerTimeout;
+  while (ring->readers.load(std::memory_order_acquire) < readers) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      std::cerr << "Timed out waiting for " << readers
+                << " reader(s) of shared memory " << shmName << "\n";
+      exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+SharedMemoryOutput::~SharedMemoryOutput() {
+  ring->closed.store(1, std::memory_order_release);
+  // Readers detach once they have read all events and seen the close.
+  auto deadline = std::chrono::steady_clock::now() + readerTimeout;
+  while (readers > 0 && ring->readers.load(std::memory_order_acquire) > 0 &&
+         std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  munmap(ring, bytes);
+  // Readers that are attached keep their mapping.
+  shm_unlink(shmName.c_str());
+}
+
+void SharedMemoryOutput::trigger(Event &e) {
+  // Never wait for readers, a slow reader detects that it was overrun.
+  Shm::SlotHeader *s = Shm::slotFor(ring, seq);
+  s->seq.store(2 * seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  struct iovec iov[3];
+  char *dst = Shm::slotData(s);
+  size_t n = 0;
+  for (int i = 0, segs = e.gather(iov); i < segs; ++i) {
+    size_t len = std::min<size_t>(iov[i].iov_len, ring->slotSize - n);
+    std::memcpy(dst + n, iov[i].iov_base, len);
+    n += len;
+  }
+  s->time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                e.time.time_since_epoch())
+                .count();
+  s->size = n;
+  s->flags = n < e.size() ? Shm::slotTruncated : 0;
+
+  s->seq.store(2 * seq + 2, std::memory_order_release);
+  ring->head.store(++seq, std::memory_order_release);
+}
+
+} // namespace TurboEvents
@@ -0,0 +1,40 @@
+#ifndef SHAREDMEMORYOUTPUT_HPP
+#define SHAREDMEMORYOUTPUT_HPP
+
+#include "turboevents-internal.hpp"
+#include "turboevents-shm.hpp"
+#include <chrono>
+#include <string>
+
+namespace TurboEvents {
+
+/// Output object publishing events in a shared-memory ring.
+class SharedMemoryOutput : public Output {
+public:
+  /// Constructor, wait for the given number of readers to attach.
+  SharedMemoryOutput(std::string name, uint64_t slots, uint32_t slotSize,
+                     uint32_t readers);
+  /// Destructor, wait for the readers to see that the ring is closed.
+  virtual ~SharedMemoryOutput() override;
+
+  /// Copy the event into the next slot of the ring.
+  void trigger(Event &e) override;
+
+private:
+  /// Name of the shared memory object.
+  std::string shmName;
+  /// The mapped ring.
+  Shm::RingHeader *ring;
+  /// Size of the mapping.
+  size_t bytes;
+  /// Sequence number of the next event.
+  uint64_t seq;
+  /// Number of readers to wait for.
+  const uint32_t readers;
+
+  /// How long to wait for readers to attach or detach.
+  static constexpr std::chrono::seconds readerTimeout{10};
+};
+
+} // namespace TurboEvents
+#endif
@@ -1,9 +1,15 @@
 #include "XMLInput.hpp"
+#include "Decompressor.hpp"
+#include "Trace.hpp"
 
+#include <algorithm>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
 #include <xercesc/dom/DOM.hpp>
+#include <xercesc/framework/Wrapper4InputSource.hpp>
+#include <xercesc/sax/InputSource.hpp>
+#include <xercesc/util/BinInputStream.hpp>
 #include <xercesc/util/PlatformUtils.hpp>
 #include <xercesc/util/XMLString.hpp>
 
@@ -21,27 +27,56 @@ public:
   virtual ~XMLInput();
 
   /// Open an XML-file and add one or more event streams based on its contents
-  void addStreamsFromXMLFile(Config &cfg,
-                             std::function<void(EventStream *)> push,
-                             const char *fname,
-                             std::vector<std::vector<std::string>> &control);
+  void
+  addStreamsFromXMLFile(Config &cfg, std::function<void(EventStream *)> push,
+                        const char *fname,
+                        const std::vector<std::vector<std::string>> &control);
 
 private:
   /// Event stream objects for open streams.
   std::vector<std::unique_ptr<ContainerStream>> streams;
-  /// Traversing a parsed XML file
-  void addStreamsFromNode(Config &cfg, std::function<void(EventStream *)> push,
-                          std::string ctx, bool &firstEvent,
-                          std::chrono::nanoseconds &shift,
-                          std::vector<std::string> &str, DOMNode *node);
-  /// Read attribute value from an XML element
-  std::string getAttrVal(DOMNamedNodeMap *attrs, XMLCh *attrTag);
 };
 
 static std::unique_ptr<XMLInput> xmlInput;
 
+/// Xerces input stream reading from a DecompressingReader.
+class DecompressingInputStream : public BinInputStream {
+public:
+  /// Constructor
+  DecompressingInputStream(const std::string &fileName) : reader(fileName) {}
+
+  XMLFilePos curPos() const override { return reader.position(); }
+
+  XMLSize_t readBytes(XMLByte *const toFill,
+                      const XMLSize_t maxToRead) override {
+    return reader.read(reinterpret_cast<char *>(toFill), maxToRead);
+  }
+
+  const XMLCh *getContentType() const override { return nullptr; }
+
+private:
+  DecompressingReader reader; ///< The decompressed file.
+};
+
+/// Xerces input source for a compressed XML file.
+class DecompressingInputSource : public InputSource {
+public:
+  /// Constructor
+  DecompressingInputSource(const char *fileName)
+      : InputSource(fileName), fname(fileName) {}
+
+  /// Start decompressing, the parser adopts the stream.
+  BinInputStream *makeStream() const override {
+    return new DecompressingInputStream(fname);
+  }
+
+private:
+  std::string fname; ///< The name of the file.
+};
+
 void XMLFileInput::addStreams(Config &cfg,
                               std::function<void(EventStream *)> push) {
+  TE_TRACE_SCOPE(xml_load);
   // First, ensure that the XML system is up and running.
   if (!xmlInput) xmlInput = std::make_unique<XMLInput>();
   xmlInput->addStreamsFromXMLFile(cfg, push, fname.c_str(), control);
@@ -120,9 +155,241 @@ XMLInput::~XMLInput() { XMLPlatformUtils::Terminate(); }
  *
  * *********************************************************************/
 
+/// An element descriptor of a control string, compiled for matching.
+struct ElementDescriptor {
+  std::string tag;            ///< The element tag.
+  XMLCh *xmlTag;              ///< The element tag, transcoded.
+  bool anyTag;                ///< Whether the tag is '*', matching all.
+  bool tagIsValue;            ///< Whether the tag is part of the payload.
+  std::vector<XMLCh *> attrs; ///< The attribute names, transcoded.
+};
+
+/// An event found in the document, before the time shift is known.
+struct PendingEvent {
+  /// The time stamp, not shifted.
+  std::chrono::system_clock::time_point time;
+  /// The payload following the time stamp and the context.
+  std::string tail;
+};
+
+/// A stream found in the document.
+struct PendingStream {
+  /// Document order of the elements enclosing the stream.
+  std::vector<uint64_t> path;
+  /// The part of the payload common to all events.
+  std::string ctx;
+  /// The events, in document order.
+  std::vector<PendingEvent> events;
+};
+
+/// The stream descriptors of a control string compiled into a matcher
+/// that finds the streams of all descriptors in a single pass over a
+/// document.
+///
+/// The matcher keeps the partial matches of the descriptors that
+/// enclose the current element. When an element matches the next
+/// element descriptor of a partial match, the match is extended for the
+/// descendants of the element. A partial match that covers all but the
+/// last element descriptor is a stream, and the elements matching the
+/// last element descriptor inside it are its events.
+class ControlMatcher {
+public:
+  /// Constructor, compiles the stream descriptors.
+  explicit ControlMatcher(const std::vector<std::vector<std::string>> &control);
+  /// Destructor
+  ~ControlMatcher();
+
+  /// Find the streams of all descriptors in the document.
+  void match(DOMDocument *doc);
+
+  /// The streams found for each descriptor, in the order of the
+  /// enclosing elements in the document.
+  std::vector<std::vector<PendingStream>> streams;
+
+private:
+  /// A partial match of a stream descriptor.
+  struct Partial {
+    size_t desc;                ///< Index of the stream descriptor.
+    size_t level;               ///< Number of element descriptors matched.
+    std::string ctx;            ///< The context collected so far.
+    std::vector<uint64_t> path; ///< Document order of matched elements.
+    size_t stream;              ///< Index of the stream, when complete.
+  };
+
+  /// Match an element and its descendants.
+  void visit(DOMElement *elem);
+  /// Add an event element to a stream.
+  void addEvent(PendingStream &stream, const ElementDescriptor &ed,
+                DOMNamedNodeMap *attrs);
+
+  /// The compiled stream descriptors.
+  std::vector<std::vector<ElementDescriptor>> descs;
+  /// Partial matches enclosing the current element.
+  std::vector<Partial> active;
+  /// Number of elements visited.
+  uint64_t order = 0;
+};
+
+/// Read attribute value from an XML element
+static std::string getAttrVal(DOMNamedNodeMap *attrs, const XMLCh *attrTag) {
+  std::string result;
+  auto *attr = attrs->getNamedItem(attrTag);
+  if (attr != nullptr) {
+    char *attrVal = XMLString::transcode(attr->getNodeValue());
+    result = attrVal;
+    XMLString::release(&attrVal);
+  }
+  return result;
+}
+
+/// Render a time stamp the way it appears at the start of event payloads.
+static std::string formatTime(std::chrono::system_clock::time_point tp) {
+  std::time_t tptime = std::chrono::system_clock::to_time_t(tp);
+  char buf[100];
+
+  // The use of std::localtime is unfortunate since it is not
+  // guaranteed to be reentrant. For the time being it works since
+  // turboevents is single threaded.
+  size_t n = std::strftime(buf, sizeof(buf), "%d-%m-%Y %H:%M:%S",
+                           std::localtime(&tptime));
+  return std::string(buf, n);
+}
+
+/// Copy an event to a later pass of a looped run, re-rendering the time
+/// stamp at the start of the payload.
+static std::unique_ptr<Event> retime(const Event &e,
+                                     std::chrono::nanoseconds offset) {
+  const auto tp = e.time + offset;
+  return e.copyWithPrefix(tp, formatTime(e.time).size(), formatTime(tp));
+}
+
+ControlMatcher::ControlMatcher(
+    const std::vector<std::vector<std::string>> &control) {
+  static const XMLCh star[] = {chAsterisk, chNull};
+  for (auto &desc : control) {
+    if (desc.empty()) continue;
+    std::vector<ElementDescriptor> eds;
+    for (auto &elemDesc : desc) {
+      std::vector<std::string> items;
+      std::istringstream iss(elemDesc);
+      std::string item;
+      while (std::getline(iss, item, ':')) items.push_back(item);
+      ElementDescriptor ed;
+      ed.tagIsValue = !items.empty() && items[0].empty();
+      if (ed.tagIsValue) items.erase(items.begin());
+      if (items.empty()) {
+        std::cerr << "Empty element descriptor in '" << elemDesc << "'\n";
+        exit(1);
+      }
+      ed.tag = items[0];
+      ed.xmlTag = XMLString::transcode(ed.tag.c_str());
+      ed.anyTag = XMLString::equals(ed.xmlTag, star);
+      for (size_t i = 1; i < items.size(); ++i)
+        ed.attrs.push_back(XMLString::transcode(items[i].c_str()));
+      eds.push_back(std::move(ed));
+    }
+    if (eds.back().attrs.empty()) {
+      std::cerr << "No time stamp attribute for '" << eds.back().tag << "'\n";
+      exit(1);
+    }
+    descs.push_back(std::move(eds));
+  }
+}
+
+ControlMatcher::~ControlMatcher() {
+  for (auto &eds : descs)
+    for (auto &ed : eds) {
+      XMLString::release(&ed.xmlTag);
+      for (XMLCh *attr : ed.attrs) XMLString::release(&attr);
+    }
+}
+
+void ControlMatcher::match(DOMDocument *doc) {
+  streams.assign(descs.size(), {});
+  active.clear();
+  for (size_t d = 0; d < descs.size(); ++d) {
+    Partial p{d, 0, "", {}, 0};
+    // A descriptor with a single element descriptor is a stream of the
+    // whole document.
+    if (descs[d].size() == 1) {
+      if (descs[d][0].tagIsValue) p.ctx += "," + descs[d][0].tag;
+      streams[d].push_back({{}, p.ctx, {}});
+    }
+    active.push_back(std::move(p));
+  }
+  if (doc && doc->getDocumentElement()) visit(doc->getDocumentElement());
+  // Nested elements with the same tag make streams complete in another
+  // order than the enclosing elements appear in the document.
+  for (auto &ss : streams)
+    std::stable_sort(ss.begin(), ss.end(), [](auto &a, auto &b) {
+      return a.path < b.path;
+    });
+}
+
+void ControlMatcher::visit(DOMElement *elem) {
+  const uint64_t idx = order++;
+  const XMLCh *name = elem->getTagName();
+  DOMNamedNodeMap *attrs = elem->getAttributes();
+  // Only extend the matches of the enclosing elements.
+  const size_t enclosing = active.size();
+  for (size_t i = 0; i < enclosing; ++i) {
+    const size_t d = active[i].desc;
+    const size_t level = active[i].level;
+    const ElementDescriptor &ed = descs[d][level];
+    if (!ed.anyTag && !XMLString::equals(name, ed.xmlTag)) continue;
+    if (level + 1 == descs[d].size()) {
+      addEvent(streams[d][active[i].stream], ed, attrs);
+      continue;
+    }
+    Partial p{d, level + 1, active[i].ctx, active[i].path, 0};
+    if (ed.tagIsValue) p.ctx += "," + ed.tag;
+    for (XMLCh *attr : ed.attrs) p.ctx += "," + getAttrVal(attrs, attr);
+    p.path.push_back(idx);
+    if (p.level + 1 == descs[d].size()) {
+      const ElementDescriptor &last = descs[d][p.level];
+      if (last.tagIsValue) p.ctx += "," + last.tag;
+      p.stream = streams[d].size();
+      streams[d].push_back({p.path, p.ctx, {}});
+    }
+    active.push_back(std::move(p));
+  }
+  for (DOMNode *c = elem->getFirstChild(); c; c = c->getNextSibling())
+    if (c->getNodeType() == DOMNode::ELEMENT_NODE)
+      visit(static_cast<DOMElement *>(c));
+  active.resize(enclosing);
+}
+
+void ControlMatcher::addEvent(PendingStream &stream,
+                              const ElementDescriptor &ed,
+                              DOMNamedNodeMap *attrs) {
+  // The first attribute is the time stamp.
+  auto *tsAttr = attrs->getNamedItem(ed.attrs[0]);
+  if (!tsAttr) {
+    std::cerr << "Event '" << ed.tag << "' without time stamp\n";
+    exit(1);
+  }
+  char *timeStamp = XMLString::transcode(tsAttr->getNodeValue());
+
+  // Use strptime, libstdc++ has numerous issues with std::get_time
+  // before 2022 (https://gcc.gnu.org/bugzilla/show_bug.cgi?id=78714).
+  struct tm timeBuf = {};
+  char *rv = strptime(timeStamp, "%d-%m-%Y %H:%M:%S", &timeBuf);
+  if (!rv) {
+    std::cerr << "Could not parse time: '" << timeStamp << "'\n";
+    exit(1);
+  }
+  XMLString::release(&timeStamp);
+
+  PendingEvent e{std::chrono::system_clock::from_time_t(std::mktime(&timeBuf)),
+                 ""};
+  for (size_t i = 1; i < ed.attrs.size(); ++i)
+    e.tail += "," + getAttrVal(attrs, ed.attrs[i]);
+  stream.events.push_back(std::move(e));
+}
+
 void XMLInput::addStreamsFromXMLFile(
     Config &cfg, std::function<void(EventStream *)> push, const char *fname,
-    std::vector<std::vector<std::string>> &control) {
+    const std::vector<std::vector<std::string>> &control) {
   XMLCh tempStr[100];
   XMLString::transcode("LS", tempStr, 99);
   DOMImplementation *impl =
@@ -133,7 +400,13 @@ void XMLInput::addStreamsFromXMLFile(
   DOMDocument *doc = nullptr;
 
   try {
-    doc = parser->parseURI(fname);
+    if (DecompressingReader::isCompressed(fname)) {
+      // Decompress on a background thread while parsing.
+      DecompressingInputSource src(fname);
+      Wrapper4InputSource in(&src, false);
+      doc = parser->parse(&in);
+    } else
+      doc = parser->parseURI(fname);
   } catch (const XMLException &toCatch) {
     char *message = XMLString::transcode(toCatch.getMessage());
     std::cerr << "Exception message is:\n" << message << "\n";
@@ -149,112 +422,39 @@ void XMLInput::addStreamsFromXMLFile(
     exit(-1);
   }
 
-  bool firstEvent = true;
-  std::chrono::nanoseconds shift(0);
-  for (auto &ctrl : control)
-    addStreamsFromNode(cfg, push, "", firstEvent, shift, ctrl, doc);
+  ControlMatcher matcher(control);
+  matcher.match(doc);
   parser->release();
-}
 
-std::string XMLInput::getAttrVal(DOMNamedNodeMap *attrs, XMLCh *attrTag) {
-  std::string result;
-  auto *attr = attrs->getNamedItem(attrTag);
-  if (attr != nullptr) {
-    char *attrVal = XMLString::transcode(attr->getNodeValue());
-    result = attrVal;
-    XMLString::release(&attrVal);
-  }
-  return result;
-}
-
-void XMLInput::addStreamsFromNode(Config &cfg,
-                                  std::function<void(EventStream *)> push,
-                                  std::string ctx, bool &firstEvent,
-                                  std::chrono::nanoseconds &shift,
-                                  std::vector<std::string> &str,
-                                  DOMNode *node) {
-  std::vector<std::string> items;
-  std::istringstream iss(str[0]);
-  std::string item;
-  while (std::getline(iss, item, ':')) items.push_back(item);
-  str.erase(str.begin());
-
-  // Recursive case; there are more element tags after this one.
-  const bool moreTags = items[0].empty();
-  if (moreTags) items.erase(items.begin());
-
-  XMLCh *elemTag = XMLString::transcode(items[0].c_str());
-  DOMNodeList *nodes = nullptr;
-  if (node->getNodeType() == DOMNode::ELEMENT_NODE)
-    nodes = static_cast<DOMElement *>(node)->getElementsByTagName(elemTag);
-  else if (node->getNodeType() == DOMNode::DOCUMENT_NODE)
-    nodes = static_cast<DOMDocument *>(node)->getElementsByTagName(elemTag);
-  XMLString::release(&elemTag);
-  if (!nodes) return;
-
-  std::vector<XMLCh *> attrTags;
-  for (auto i = 0; auto &t : items)
-    if (i++ > 0) attrTags.push_back(XMLString::transcode(t.c_str()));
-
-  const std::string comma = ",";
-  if (moreTags) ctx += comma + items[0];
-
-  if (!str.empty()) {
-    for (XMLSize_t nodeIdx = 0; nodeIdx < nodes->getLength(); ++nodeIdx) {
-      std::string lctx = ctx;
-      DOMNode *lnode = nodes->item(nodeIdx);
-      for (XMLCh *attrTag : attrTags)
-        lctx += comma + getAttrVal(lnode->getAttributes(), attrTag);
-      addStreamsFromNode(cfg, push, lctx, firstEvent, shift, str, lnode);
-    }
-    for (XMLCh *attrTag : attrTags) XMLString::release(&attrTag);
-    return;
-  }
+  // Make the events, in the order the streams would be found by
+  // traversing the document once for each stream descriptor.
+  bool firstEvent = true;
+  std::chrono::nanoseconds shift(0);
+  for (auto &descStreams : matcher.streams)
+    for (auto &ps : descStreams) {
+      std::vector<std::unique_ptr<Event>> events;
+      // The context is the same for all events of the stream, share it
+      // unless that takes more memory than copying it.
+      auto sharedCtx = std::make_shared<const std::string>(ps.ctx);
+      for (auto &pe : ps.events) {
+        auto tp = pe.time;
+        if (firstEvent) {
+          if (cfg.tshift) shift = cfg.start - tp;
+          firstEvent = false;
+        }
+        tp += shift;
 
-  // Read events
-  // The first attribute tag is the name of the time stamp, peel it off
-  XMLCh *tsTag = attrTags[0];
-  attrTags.erase(attrTags.begin());
-  std::vector<std::unique_ptr<Event>> events;
-  for (XMLSize_t nodeIdx = 0; nodeIdx < nodes->getLength(); ++nodeIdx) {
-    auto *attrs = nodes->item(nodeIdx)->getAttributes();
-
-    char *timeStamp =
-        XMLString::transcode(attrs->getNamedItem(tsTag)->getNodeValue());
-
-    // Use strptime, libstdc++ has numerous issues with std::get_time
-    // before 2022 (https://gcc.gnu.org/bugzilla/show_bug.cgi?id=78714).
-    struct tm timeBuf = {};
-    char *rv = strptime(timeStamp, "%d-%m-%Y %H:%M:%S", &timeBuf);
-    if (!rv)
-      std::throw_with_nested(std::runtime_error("Could not parse time: '" +
-                                                std::string(timeStamp) + "'"));
-    XMLString::release(&timeStamp);
-    auto tp = std::chrono::system_clock::from_time_t(std::mktime(&timeBuf));
-
-    if (firstEvent) {
-      if (cfg.tshift) shift = cfg.start - tp;
-      firstEvent = false;
+        std::string csv = formatTime(tp);
+        const size_t tsLen = csv.size();
+        csv += pe.tail;
+        events.push_back(
+            cfg.makeSharedEvent(tp, std::move(csv), sharedCtx, tsLen));
+      }
+      // The fields are always separated by commas.
+      streams.push_back(
+          std::make_unique<ContainerStream>(std::move(events), ',', retime));
+      push(streams.back().get());
     }
-    tp += shift;
-
-    std::time_t tptime = std::chrono::system_clock::to_time_t(tp);
-    char buf[100];
-
-    // The use of std::localtime is unfortunate since it is not guaranteed
-    // to be reentrant. For the time being it works since turboevents is
-    // single threaded.
-    std::strftime(buf, sizeof(buf), "%d-%m-%Y %H:%M:%S",
-                  std::localtime(&tptime));
-    std::string csv = buf;
-    csv += ctx;
-    for (XMLCh *attrTag : attrTags) csv += comma + getAttrVal(attrs, attrTag);
-    events.push_back(cfg.makeEvent(tp, csv));
-  }
-  streams.push_back(std::make_unique<ContainerStream>(std::move(events)));
-  push(streams.back().get());
-  XMLString::release(&tsTag);
-  for (XMLCh *attrTag : attrTags) XMLString::release(&attrTag);
 }
 
 } // namespace TurboEvents
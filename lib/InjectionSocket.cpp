@@ -0,0 +1,85 @@
+#include "InjectionSocket.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace TurboEvents {
+
+InjectionSocket::InjectionSocket(std::string p,
+                                 std::function<void(std::string_view)> line)
+    : path(std::move(p)), onLine(std::move(line)) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Socket path too long: " << path << "\n";
+    exit(1);
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path.c_str());
+  if (listenFd < 0 ||
+      bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr),
+           sizeof(addr)) != 0 ||
+      listen(listenFd, 16) != 0) {
+    std::cerr << "Failed to listen on " << path << ": " << strerror(errno)
+              << "\n";
+    exit(1);
+  }
+  thread = std::thread(&InjectionSocket::serve, this);
+}
+
+InjectionSocket::~InjectionSocket() {
+  stopping = true;
+  thread.join();
+  close(listenFd);
+  unlink(path.c_str());
+}
+
+void InjectionSocket::serve() {
+  // The listening socket first, then the clients.
+  std::vector<struct pollfd> fds = {{listenFd, POLLIN, 0}};
+  // Partial lines received from each client.
+  std::vector<std::string> partial = {""};
+  char buf[4096];
+  while (!stopping) {
+    // Wake up regularly to notice when the run is over.
+    if (poll(fds.data(), fds.size(), 100) <= 0) continue;
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd >= 0) {
+        fds.push_back({fd, POLLIN, 0});
+        partial.emplace_back();
+      }
+    }
+    for (size_t i = 1; i < fds.size(); ++i) {
+      if (!fds[i].revents) continue;
+      ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+      if (n > 0) {
+        partial[i].append(buf, n);
+        size_t start = 0;
+        for (size_t eol; (eol = partial[i].find('\n', start)) !=
+                         std::string::npos;
+             start = eol + 1)
+          onLine(std::string_view(partial[i]).substr(start, eol - start));
+        partial[i].erase(0, start);
+        continue;
+      }
+      // The client is gone, a last line may lack its newline.
+      if (!partial[i].empty()) onLine(partial[i]);
+      close(fds[i].fd);
+      fds.erase(fds.begin() + i);
+      partial.erase(partial.begin() + i);
+      --i;
+    }
+  }
+  for (size_t i = 1; i < fds.size(); ++i) close(fds[i].fd);
+}
+
+} // namespace TurboEvents
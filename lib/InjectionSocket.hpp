@@ -0,0 +1,43 @@
+#ifndef INJECTIONSOCKET_HPP
+#define INJECTIONSOCKET_HPP
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace TurboEvents {
+
+/// A Unix domain socket that local clients write events to, one per
+/// line, for instance with
+///   echo 'fault,42' | nc -U /tmp/turboevents.sock
+///
+/// A background thread accepts any number of clients and passes each
+/// complete line to a callback. The callback runs on that thread.
+class InjectionSocket {
+public:
+  /// Constructor, listen on path, replacing any socket already there.
+  InjectionSocket(std::string path,
+                  std::function<void(std::string_view)> line);
+  /// Destructor, stops the thread and removes the socket.
+  ~InjectionSocket();
+
+private:
+  /// Body of the background thread.
+  void serve();
+
+  /// Path of the socket.
+  const std::string path;
+  /// Called for each line received.
+  const std::function<void(std::string_view)> onLine;
+  /// The listening socket.
+  int listenFd;
+  /// Set to stop the thread.
+  std::atomic<bool> stopping{false};
+  /// The background thread.
+  std::thread thread;
+};
+
+} // namespace TurboEvents
+#endif
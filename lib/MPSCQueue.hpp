@@ -0,0 +1,69 @@
+#ifndef MPSCQUEUE_HPP
+#define MPSCQUEUE_HPP
+
+#include <atomic>
+#include <utility>
+
+namespace TurboEvents {
+
+/// Unbounded lock-free queue with many producers and a single consumer.
+///
+/// This is Dmitry Vyukov's intrusive MPSC queue. A push is one atomic
+/// exchange and one store, so producers never wait for each other or
+/// for the consumer. The queue is a linked list from tail to head with
+/// a dummy node at the tail. A producer swaps its node in as the new
+/// head and then links the previous head to it; until that link is
+/// made the consumer sees the queue as ending before the new node,
+/// which only delays the node until the next pop.
+template <typename T> class MPSCQueue {
+public:
+  /// Constructor
+  MPSCQueue() : head(new Node()), tail(head.load()) {}
+  MPSCQueue(const MPSCQueue &) = delete;
+  MPSCQueue &operator=(const MPSCQueue &) = delete;
+  /// Destructor, must not run concurrently with push().
+  ~MPSCQueue() {
+    while (Node *n = tail) {
+      tail = n->next.load(std::memory_order_relaxed);
+      delete n;
+    }
+  }
+
+  /// Add a value, from any thread.
+  void push(T value) {
+    Node *n = new Node(std::move(value));
+    Node *prev = head.exchange(n, std::memory_order_acq_rel);
+    prev->next.store(n, std::memory_order_release);
+  }
+
+  /// Take the oldest value, from the consumer thread only. Return false
+  /// if there is none.
+  bool pop(T &value) {
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (!next) return false;
+    value = std::move(next->value);
+    delete tail;
+    tail = next;
+    return true;
+  }
+
+private:
+  /// A node of the list.
+  struct Node {
+    /// Constructor for the dummy node.
+    Node() : next(nullptr) {}
+    /// Constructor
+    explicit Node(T v) : next(nullptr), value(std::move(v)) {}
+
+    std::atomic<Node *> next; ///< The node pushed after this one.
+    T value;                  ///< The value, moved out when popped.
+  };
+
+  /// The most recently pushed node, shared by the producers.
+  alignas(64) std::atomic<Node *> head;
+  /// The dummy node before the oldest value, owned by the consumer.
+  alignas(64) Node *tail;
+};
+
+} // namespace TurboEvents
+#endif
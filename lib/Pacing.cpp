@@ -0,0 +1,102 @@
+#include "Pacing.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+namespace TurboEvents {
+
+RatePacer::RatePacer(std::vector<std::pair<double, double>> profile,
+                     double reportSeconds)
+    : points(std::move(profile)), reportInterval(reportSeconds), count(0),
+      lastCount(0) {
+  if (points.empty()) {
+    std::cerr << "Empty rate profile\n";
+    exit(1);
+  }
+  for (size_t i = 0; i < points.size(); ++i) {
+    if (points[i].second <= 0) {
+      std::cerr << "Rates in rate profile must be positive\n";
+      exit(1);
+    }
+    if (i > 0 && points[i].first <= points[i - 1].first) {
+      std::cerr << "Times in rate profile must be increasing\n";
+      exit(1);
+    }
+  }
+}
+
+double RatePacer::rate(double seconds) const {
+  if (seconds <= points.front().first) return points.front().second;
+  for (size_t i = 1; i < points.size(); ++i) {
+    auto [t1, r1] = points[i];
+    if (seconds < t1) {
+      auto [t0, r0] = points[i - 1];
+      return r0 + (r1 - r0) * (seconds - t0) / (t1 - t0);
+    }
+  }
+  return points.back().second;
+}
+
+std::chrono::system_clock::time_point
+RatePacer::due(std::chrono::system_clock::time_point) {
+  auto now = std::chrono::system_clock::now();
+  if (count == 0) start = next = lastReport = now;
+  // Do not let a backlog grow without bound, the bucket only holds a
+  // small burst of events.
+  auto burst = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(burstSeconds));
+  if (now - next > burst) next = now - burst;
+  return next;
+}
+
+void RatePacer::emitted() {
+  ++count;
+  const std::chrono::duration<double> elapsed = next - start;
+  next += std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(1.0 / rate(elapsed.count())));
+  if (reportInterval.count() <= 0) return;
+  auto now = std::chrono::system_clock::now();
+  if (now - lastReport >= reportInterval) report(now);
+}
+
+void RatePacer::report(std::chrono::system_clock::time_point now) {
+  const std::chrono::duration<double> sinceStart = now - start;
+  const std::chrono::duration<double> sinceReport = now - lastReport;
+  char buf[128];
+  snprintf(buf, sizeof(buf),
+           "pacing: t=%.1fs target=%.0f eps achieved=%.0f eps\n",
+           sinceStart.count(), rate(sinceStart.count()),
+           (count - lastCount) / sinceReport.count());
+  std::cerr << buf;
+  lastReport = now;
+  lastCount = count;
+}
+
+void RatePacer::finish() {
+  if (count == 0) return;
+  auto now = std::chrono::system_clock::now();
+  const std::chrono::duration<double> total = now - start;
+  // The target is the mean of the profile over the run.
+  double target = 0;
+  const int steps = 1000;
+  for (int i = 0; i < steps; ++i)
+    target += rate(total.count() * (i + 0.5) / steps) / steps;
+  char buf[128];
+  snprintf(buf, sizeof(buf),
+           "pacing: %llu events in %.3fs, target=%.0f eps achieved=%.0f "
+           "eps\n",
+           static_cast<unsigned long long>(count), total.count(), target,
+           count / total.count());
+  std::cerr << buf;
+}
+
+void GapPacer::finish() {
+  pacer->finish();
+  char buf[128];
+  snprintf(buf, sizeof(buf), "max_gap: cut %llu gaps by %.3fs\n",
+           static_cast<unsigned long long>(gaps),
+           std::chrono::duration<double>(cut).count());
+  std::cerr << buf;
+}
+
+} // namespace TurboEvents
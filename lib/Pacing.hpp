@@ -0,0 +1,152 @@
+#ifndef PACING_HPP
+#define PACING_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace TurboEvents {
+
+/// A policy deciding when the events of a run are emitted.
+class Pacer {
+public:
+  /// Virtual destructor
+  virtual ~Pacer() = default;
+
+  /// Wall-clock time when the next event, with time stamp t, is due.
+  virtual std::chrono::system_clock::time_point
+  due(std::chrono::system_clock::time_point t) = 0;
+  /// Note that the event most recently passed to due() was emitted.
+  virtual void emitted() {}
+  /// Note that the run has ended.
+  virtual void finish() {}
+};
+
+/// Emit events at their time stamps, with the gaps between them scaled.
+class ScalePacer : public Pacer {
+public:
+  /// Constructor
+  ScalePacer(std::chrono::system_clock::time_point s, double f)
+      : ScalePacer(s, s, f) {}
+  /// Constructor for events at s being due at b instead.
+  ScalePacer(std::chrono::system_clock::time_point s,
+             std::chrono::system_clock::time_point b, double f)
+      : start(s), begin(b), scale(f) {}
+
+  std::chrono::system_clock::time_point
+  due(std::chrono::system_clock::time_point t) override {
+    return begin + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       scale * (t - start));
+  }
+
+private:
+  /// Start of the run.
+  const std::chrono::system_clock::time_point start;
+  /// Wall-clock time when events at the start are due.
+  const std::chrono::system_clock::time_point begin;
+  /// Factor applied to intervals between events.
+  const double scale;
+};
+
+/// Emit events in order at a rate following a profile, ignoring their
+/// time stamps.
+///
+/// The profile is a list of (seconds since start, events per second)
+/// points. The target rate is interpolated linearly between points and
+/// held constant before the first and after the last point. Events are
+/// scheduled 1/rate apart like tokens from a bucket; when emission
+/// falls behind, at most burstSeconds worth of events are sent back to
+/// back to catch up.
+class RatePacer : public Pacer {
+public:
+  /// Constructor
+  RatePacer(std::vector<std::pair<double, double>> profile,
+            double reportSeconds = 1.0);
+
+  std::chrono::system_clock::time_point
+  due(std::chrono::system_clock::time_point t) override;
+  void emitted() override;
+  void finish() override;
+
+  /// Target rate in events per second at some time after the start.
+  double rate(double seconds) const;
+
+private:
+  /// Print the achieved and target rates since the last report.
+  void report(std::chrono::system_clock::time_point now);
+
+  /// Maximum backlog to catch up with, in seconds.
+  static constexpr double burstSeconds = 0.1;
+
+  /// The rate profile.
+  const std::vector<std::pair<double, double>> points;
+  /// Interval between reports, 0 for no periodic reports.
+  const std::chrono::duration<double> reportInterval;
+  /// Wall-clock time of the first event.
+  std::chrono::system_clock::time_point start;
+  /// Scheduled time of the next event.
+  std::chrono::system_clock::time_point next;
+  /// Time of the last report.
+  std::chrono::system_clock::time_point lastReport;
+  /// Events emitted in total.
+  uint64_t count;
+  /// Events emitted at the time of the last report.
+  uint64_t lastCount;
+};
+
+/// Cut idle gaps between events down to a maximum before pacing.
+///
+/// Events are passed on to another pacer with their times moved earlier
+/// by the sum of the excess of all gaps so far, where the excess of a
+/// gap is how much longer than maxGap it is. Since the gaps are between
+/// consecutive events of the merge, the cut applies to all streams
+/// alike, and the timing within bursts of events is kept. The gaps cut
+/// are reported when the run ends.
+class GapPacer : public Pacer {
+public:
+  /// Constructor
+  GapPacer(std::unique_ptr<Pacer> p, std::chrono::nanoseconds g)
+      : pacer(std::move(p)), maxGap(g), cut(0) {}
+
+  std::chrono::system_clock::time_point
+  due(std::chrono::system_clock::time_point t) override {
+    pendingTime = t;
+    return pacer->due(t - cut - excess(t));
+  }
+  void emitted() override {
+    const auto e = excess(pendingTime);
+    if (e.count() > 0) ++gaps;
+    cut += e;
+    if (!started || pendingTime > lastTime) lastTime = pendingTime;
+    started = true;
+    pacer->emitted();
+  }
+  void finish() override;
+
+private:
+  /// How much longer than maxGap the gap before an event at t is.
+  std::chrono::nanoseconds excess(std::chrono::system_clock::time_point t) {
+    if (!started || t - lastTime <= maxGap) return std::chrono::nanoseconds(0);
+    return t - lastTime - maxGap;
+  }
+
+  /// The pacer of the compressed times.
+  std::unique_ptr<Pacer> pacer;
+  /// The longest gap kept.
+  const std::chrono::nanoseconds maxGap;
+  /// Time cut from the gaps so far.
+  std::chrono::nanoseconds cut;
+  /// Number of gaps cut so far.
+  uint64_t gaps = 0;
+  /// Time of the latest event emitted.
+  std::chrono::system_clock::time_point lastTime;
+  /// Time of the event most recently passed to due().
+  std::chrono::system_clock::time_point pendingTime;
+  /// Whether an event has been emitted.
+  bool started = false;
+};
+
+} // namespace TurboEvents
+#endif
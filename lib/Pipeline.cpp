@@ -0,0 +1,273 @@
+#include "Pipeline.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <iostream>
+#include <string_view>
+
+namespace TurboEvents {
+
+/// The payload of an event in one piece, assembled into buf if needed.
+static std::string_view payloadOf(const Event &e, std::string &buf) {
+  struct iovec iov[3];
+  if (e.gather(iov) == 1)
+    return std::string_view(static_cast<const char *>(iov[0].iov_base),
+                            iov[0].iov_len);
+  e.assemble(buf);
+  return buf;
+}
+
+/// Split a payload into its fields, reusing the storage of fields.
+static void splitFields(std::string_view payload, char sep,
+                        std::vector<std::string_view> &fields) {
+  fields.clear();
+  for (size_t pos = 0;;) {
+    const size_t end = std::min(payload.find(sep, pos), payload.size());
+    fields.push_back(payload.substr(pos, end - pos));
+    if (end == payload.size()) return;
+    pos = end + 1;
+  }
+}
+
+/// Keep events by the value of a field.
+class FilterOperator : public Operator {
+public:
+  /// Constructor
+  FilterOperator(size_t c, std::string v, bool eq)
+      : col(c), value(std::move(v)), equal(eq) {}
+
+  void apply(Event &e, char sep, const Emit &emit) override {
+    splitFields(payloadOf(e, buf), sep, fields);
+    const bool match = col < fields.size() && fields[col] == value;
+    if (match == equal) emit(e, sep);
+  }
+
+private:
+  const size_t col;        ///< The field to look at.
+  const std::string value; ///< The value to compare with.
+  const bool equal;        ///< Whether to keep equal or different events.
+  std::string buf;         ///< Buffer for assembled payloads.
+  std::vector<std::string_view> fields; ///< Fields of the current event.
+};
+
+/// Keep some of the fields.
+class ProjectOperator : public Operator {
+public:
+  /// Constructor
+  ProjectOperator(std::vector<size_t> c) : cols(std::move(c)) {}
+
+  void apply(Event &e, char sep, const Emit &emit) override {
+    splitFields(payloadOf(e, buf), sep, fields);
+    std::string kept;
+    for (size_t i = 0; i < cols.size(); ++i) {
+      if (i > 0) kept += sep;
+      if (cols[i] < fields.size()) kept += fields[cols[i]];
+    }
+    Event projected(e.time, std::move(kept));
+    emit(projected, sep);
+  }
+
+private:
+  const std::vector<size_t> cols;       ///< The fields to keep.
+  std::string buf;                      ///< Buffer for assembled payloads.
+  std::vector<std::string_view> fields; ///< Fields of the current event.
+};
+
+/// Rewrite a field.
+class MapOperator : public Operator {
+public:
+  /// Constructor
+  MapOperator(size_t c, const std::string &t) : col(c) {
+    for (size_t pos = 0;;) {
+      const size_t end = std::min(t.find("{}", pos), t.size());
+      pieces.push_back(t.substr(pos, end - pos));
+      if (end == t.size()) break;
+      pos = end + 2;
+    }
+  }
+
+  void apply(Event &e, char sep, const Emit &emit) override {
+    splitFields(payloadOf(e, buf), sep, fields);
+    const std::string_view old =
+        col < fields.size() ? fields[col] : std::string_view();
+    std::string d;
+    for (size_t i = 0; i < std::max(fields.size(), col + 1); ++i) {
+      if (i > 0) d += sep;
+      if (i != col) {
+        if (i < fields.size()) d += fields[i];
+        continue;
+      }
+      d += pieces[0];
+      for (size_t p = 1; p < pieces.size(); ++p) {
+        d += old;
+        d += pieces[p];
+      }
+    }
+    Event mapped(e.time, std::move(d));
+    emit(mapped, sep);
+  }
+
+private:
+  const size_t col; ///< The field to rewrite.
+  /// The new value split at each {}, where the old value goes.
+  std::vector<std::string> pieces;
+  std::string buf;                      ///< Buffer for assembled payloads.
+  std::vector<std::string_view> fields; ///< Fields of the current event.
+};
+
+/// Drop, keep or duplicate events at random.
+class RandomOperator : public Operator {
+public:
+  /// What to do with the chosen events.
+  enum class Action { Keep, Drop, Duplicate };
+
+  /// Constructor
+  RandomOperator(double p, Action a, uint64_t seed)
+      : prob(p), action(a), rng(seed) {}
+
+  void apply(Event &e, char sep, const Emit &emit) override {
+    const bool chosen = dist(rng) < prob;
+    if (action == Action::Keep && !chosen) return;
+    if (action == Action::Drop && chosen) return;
+    emit(e, sep);
+    if (action == Action::Duplicate && chosen) emit(e, sep);
+  }
+
+private:
+  const double prob;                           ///< Probability of a choice.
+  const Action action;                         ///< What chosen events get.
+  std::mt19937_64 rng;                         ///< Random generator.
+  std::uniform_real_distribution<double> dist; ///< Uniform in [0, 1).
+};
+
+/// Hold back events at random.
+class DelayOperator : public Operator {
+public:
+  /// Constructor
+  DelayOperator(double p, std::chrono::milliseconds d, uint64_t seed)
+      : prob(p), delay(d), rng(seed) {}
+
+  void apply(Event &e, char sep, const Emit &emit) override {
+    // Release the held events that are due by now.
+    while (!held.empty() && held.front().due <= e.time) {
+      Held released = std::move(held.front());
+      held.pop_front();
+      emit(*released.event, released.sep);
+    }
+    if (dist(rng) < prob) {
+      auto due = e.time + delay;
+      auto pos =
+          std::upper_bound(held.begin(), held.end(), due,
+                           [](auto t, const Held &h) { return t < h.due; });
+      held.insert(pos, {due, e.copyAt(e.time), sep});
+    } else
+      emit(e, sep);
+  }
+
+  void flush(const Emit &emit) override {
+    for (auto &h : held) emit(*h.event, h.sep);
+    held.clear();
+  }
+
+private:
+  const double prob;                         ///< Probability of a delay.
+  const std::chrono::milliseconds delay;     ///< How long to hold events.
+  std::mt19937_64 rng;                       ///< Random generator.
+  std::uniform_real_distribution<double> dist; ///< Uniform in [0, 1).
+  /// An event held back.
+  struct Held {
+    std::chrono::system_clock::time_point due; ///< When to release it.
+    std::unique_ptr<Event> event;              ///< The event.
+    char sep;                                  ///< Separator of its fields.
+  };
+  std::deque<Held> held; ///< Held events, in order of due time.
+};
+
+/// Parse all of s as a number, return whether it is one.
+template <typename T> static bool parseNumber(std::string_view s, T &v) {
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+  return ec == std::errc() && end == s.data() + s.size();
+}
+
+/// Parse all of s as a probability, return whether it is one.
+static bool parseProbability(std::string_view s, double &p) {
+  return parseNumber(s, p) && p >= 0 && p <= 1;
+}
+
+std::unique_ptr<Operator> makeOperator(const std::string &spec) {
+  std::vector<std::string> args;
+  for (size_t pos = 0;;) {
+    const size_t end = std::min(spec.find(':', pos), spec.size());
+    args.push_back(spec.substr(pos, end - pos));
+    if (end == spec.size()) break;
+    pos = end + 1;
+  }
+  const std::string &name = args[0];
+
+  if ((name == "filter" || name == "map") && args.size() == 2) {
+    const auto eq = args[1].find('=');
+    const bool notEq = name == "filter" && eq != std::string::npos &&
+                       eq > 0 && args[1][eq - 1] == '!';
+    size_t col;
+    if (eq != std::string::npos &&
+        parseNumber(std::string_view(args[1]).substr(0, eq - notEq), col)) {
+      std::string v = args[1].substr(eq + 1);
+      if (name == "map") return std::make_unique<MapOperator>(col, v);
+      return std::make_unique<FilterOperator>(col, v, !notEq);
+    }
+  } else if (name == "project" && args.size() >= 2) {
+    std::vector<size_t> cols(args.size() - 1);
+    bool ok = true;
+    for (size_t i = 1; i < args.size(); ++i)
+      ok = ok && parseNumber(args[i], cols[i - 1]);
+    if (ok) return std::make_unique<ProjectOperator>(cols);
+  } else if ((name == "sample" || name == "drop" || name == "dup") &&
+             (args.size() == 2 || args.size() == 3)) {
+    double prob;
+    uint64_t seed = 0;
+    auto action = name == "sample" ? RandomOperator::Action::Keep
+                  : name == "drop" ? RandomOperator::Action::Drop
+                                   : RandomOperator::Action::Duplicate;
+    if (parseProbability(args[1], prob) &&
+        (args.size() == 2 || parseNumber(args[2], seed)))
+      return std::make_unique<RandomOperator>(prob, action, seed);
+  } else if (name == "delay" && (args.size() == 3 || args.size() == 4)) {
+    double prob;
+    int64_t ms;
+    uint64_t seed = 0;
+    if (parseProbability(args[1], prob) && parseNumber(args[2], ms) &&
+        ms >= 0 && (args.size() == 3 || parseNumber(args[3], seed)))
+      return std::make_unique<DelayOperator>(
+          prob, std::chrono::milliseconds(ms), seed);
+  }
+  std::cerr << "Bad pipeline operator: " << spec << "\n";
+  exit(1);
+}
+
+void PipelineOutput::add(std::unique_ptr<Operator> op) {
+  ops.push_back(std::move(op));
+  emits.push_back([this, next = ops.size()](Event &e, char delim) {
+    pass(next, e, delim);
+  });
+}
+
+void PipelineOutput::triggerDelimited(Event &e, char delim) {
+  pass(0, e, delim);
+}
+
+void PipelineOutput::flush() {
+  // Flush each operator in turn, passing what it held back through the
+  // rest of the pipeline.
+  for (size_t i = 0; i < ops.size(); ++i) ops[i]->flush(emits[i]);
+  out->flush();
+}
+
+void PipelineOutput::pass(size_t i, Event &e, char delim) {
+  if (i == ops.size())
+    out->triggerDelimited(e, delim);
+  else
+    ops[i]->apply(e, delim, emits[i]);
+}
+
+} // namespace TurboEvents
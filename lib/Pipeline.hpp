@@ -0,0 +1,85 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include "turboevents-internal.hpp"
+
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace TurboEvents {
+
+/// Where an operator passes on its events, which need only live for the
+/// duration of the call, with the separator of their fields.
+using Emit = std::function<void(Event &, char)>;
+
+/// An operator transforming the events on the way to an output.
+///
+/// Operators run once per event, when the event is due, and pass on
+/// none, one or more events for it.
+class Operator {
+public:
+  /// Virtual destructor
+  virtual ~Operator() = default;
+
+  /// Transform an event with fields separated by sep, passing the results
+  /// on to emit.
+  virtual void apply(Event &e, char sep, const Emit &emit) = 0;
+  /// Pass on any events held back by the operator.
+  virtual void flush(const Emit &) {}
+};
+
+/// Create an operator from a specification such as "sample:0.1".
+///
+/// The specification is a name and arguments separated by ':'. Fields
+/// of the payloads are separated as in the stream each event comes from,
+/// such as by the delimiter of a CSV file, and numbered from 0.
+///   filter:COL=VALUE    keep events where field COL is VALUE
+///   filter:COL!=VALUE   keep events where field COL is not VALUE
+///   project:COL:...     keep only the listed fields, in that order
+///   map:COL=TEMPLATE    set field COL to TEMPLATE, where {} is replaced
+///                       by the old value, e.g. map:1=replay-{}
+///   sample:P[:SEED]     keep each event with probability P
+///   drop:P[:SEED]       drop each event with probability P
+///   dup:P[:SEED]        emit each event twice with probability P
+///   delay:P:MS[:SEED]   with probability P, hold an event back until an
+///                       event at least MS milliseconds later passes
+/// Random choices are seeded with SEED, 0 by default, so that runs are
+/// repeatable. COL, MS and SEED are non-negative integers and P is in
+/// [0, 1], anything else is reported as an error.
+std::unique_ptr<Operator> makeOperator(const std::string &spec);
+
+/// An output that passes events through a pipeline of operators.
+class PipelineOutput : public Output {
+public:
+  /// Constructor, events triggered without a separator have their fields
+  /// separated by s.
+  PipelineOutput(std::unique_ptr<Output> o, char s)
+      : out(std::move(o)), sep(s) {}
+  /// Destructor
+  virtual ~PipelineOutput() override {}
+
+  /// Add an operator to the end of the pipeline.
+  void add(std::unique_ptr<Operator> op);
+
+  void trigger(Event &e) override { triggerDelimited(e, sep); }
+  void triggerDelimited(Event &e, char delim) override;
+  void flush() override;
+
+private:
+  /// Pass an event through the operators from index i on to the output.
+  void pass(size_t i, Event &e, char delim);
+
+  /// The output at the end of the pipeline.
+  std::unique_ptr<Output> out;
+  /// Separator of the fields of events triggered without one.
+  const char sep;
+  /// The operators, in order.
+  std::vector<std::unique_ptr<Operator>> ops;
+  /// Where each operator passes on its events, the next one or the output.
+  std::vector<Emit> emits;
+};
+
+} // namespace TurboEvents
+#endif
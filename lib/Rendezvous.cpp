@@ -0,0 +1,98 @@
+#include "Rendezvous.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <thread>
+
+namespace TurboEvents {
+
+Rendezvous::~Rendezvous() {
+  // A slow process may still be reading the ready files, keep ours until
+  // emission has begun since by then everybody must have read it.
+  if (wasReady) {
+    std::this_thread::sleep_until(begin);
+    std::remove(fileFor("ready", myRank).c_str());
+  }
+  if (joined) std::remove(fileFor("rank", myRank).c_str());
+}
+
+std::string Rendezvous::fileFor(const std::string &phase, int rank) const {
+  return dir + "/" + phase + "-" + std::to_string(rank);
+}
+
+std::chrono::system_clock::time_point Rendezvous::join() {
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "Failed to create " << dir << ": " << strerror(errno) << "\n";
+    exit(1);
+  }
+  joined = true;
+  return meet("rank");
+}
+
+std::chrono::system_clock::time_point Rendezvous::ready() {
+  wasReady = true;
+  begin = meet("ready") + lead;
+  return begin;
+}
+
+std::chrono::system_clock::time_point
+Rendezvous::meet(const std::string &phase) {
+  // Publish the time atomically so that it is never read half written.
+  const auto mine = std::chrono::system_clock::now();
+  const int64_t mineNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             mine.time_since_epoch())
+                             .count();
+  const std::string file = fileFor(phase, myRank);
+  const std::string tmp = file + ".tmp";
+  {
+    std::ofstream f(tmp);
+    f << runId << "\n" << mineNs << "\n";
+    if (!f) {
+      std::cerr << "Failed to write " << tmp << "\n";
+      exit(1);
+    }
+  }
+  if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+    std::cerr << "Failed to write " << file << ": " << strerror(errno) << "\n";
+    exit(1);
+  }
+
+  for (;;) {
+    int64_t latest = mineNs;
+    bool complete = true;
+    for (int r = 0; r < ranks && complete; ++r) {
+      std::ifstream f(fileFor(phase, r));
+      std::string id;
+      int64_t ns;
+      if (!std::getline(f, id) || id != runId || !(f >> ns))
+        complete = false;
+      else
+        latest = std::max(latest, ns);
+    }
+    if (complete)
+      return std::chrono::system_clock::time_point(
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+              std::chrono::nanoseconds(latest)));
+    if (std::chrono::system_clock::now() - mine > timeout) {
+      std::cerr << "Timed out waiting for " << ranks << " processes of run "
+                << runId << " in " << dir << "\n";
+      exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+bool Rendezvous::owns(uint64_t streamId) const {
+  // splitmix64, so that consecutive ids spread over the ranks.
+  uint64_t z = streamId + 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  z ^= z >> 31;
+  return z % ranks == static_cast<uint64_t>(myRank);
+}
+
+} // namespace TurboEvents
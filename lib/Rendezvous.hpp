@@ -0,0 +1,80 @@
+#ifndef RENDEZVOUS_HPP
+#define RENDEZVOUS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace TurboEvents {
+
+/***********************************************************************
+ * Coordination of several generator processes that share one clock.
+ *
+ * Each of count processes is started with the same inputs, the same run
+ * id and a distinct rank. Since stream ids are handed out in the order
+ * the inputs create their streams, every process numbers the streams
+ * the same way, and a process only emits the streams whose hashed id
+ * maps to its rank. Together the processes emit exactly the events of a
+ * single run.
+ *
+ * The processes meet twice through files in a shared directory, each
+ * holding the run id and the time the process wrote it. Before loading,
+ * each process writes rank-<rank> and waits until the files of all
+ * ranks of the run are present; the latest of their times is the start
+ * that the inputs shift time stamps to. After loading, each process
+ * writes ready-<rank> the same way, and emission begins a short lead
+ * after the latest of those, so that no process starts before the
+ * slowest one has loaded. Files with another run id are left over from
+ * an earlier run and are waited on until they are replaced, and each
+ * process removes its files when the run ends.
+ * *********************************************************************/
+
+/// A rendezvous of a group of generator processes.
+class Rendezvous {
+public:
+  /// Constructor
+  Rendezvous(std::string directory, std::string run, int rank, int count)
+      : dir(std::move(directory)), runId(std::move(run)), myRank(rank),
+        ranks(count) {}
+  /// Destructor, removes the files of this process.
+  ~Rendezvous();
+
+  /// Wait for all processes and return the common start of the run.
+  std::chrono::system_clock::time_point join();
+  /// Wait for all processes to have loaded their inputs and return the
+  /// common time to begin emitting at.
+  std::chrono::system_clock::time_point ready();
+
+  /// Whether this process emits the stream with the given id.
+  bool owns(uint64_t streamId) const;
+
+private:
+  /// Time between the last process being ready and emission.
+  static constexpr std::chrono::milliseconds lead{100};
+  /// How long to wait for the other processes.
+  static constexpr std::chrono::seconds timeout{300};
+
+  /// Write the current time to the file of this process for a phase,
+  /// wait for the files of all ranks and return the latest time.
+  std::chrono::system_clock::time_point meet(const std::string &phase);
+  /// The file holding the time of a rank in a phase.
+  std::string fileFor(const std::string &phase, int rank) const;
+
+  /// The directory shared by the processes.
+  std::string dir;
+  /// Identifies the run among the files in the directory.
+  std::string runId;
+  /// The rank of this process.
+  int myRank;
+  /// The number of processes.
+  int ranks;
+  /// The agreed time to begin emitting, if ready.
+  std::chrono::system_clock::time_point begin;
+  /// Whether join() has written a file.
+  bool joined = false;
+  /// Whether ready() has written a file.
+  bool wasReady = false;
+};
+
+} // namespace TurboEvents
+#endif
@@ -0,0 +1,94 @@
+#include "Stats.hpp"
+#include "turboevents.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+
+namespace TurboEvents {
+
+std::atomic<uint64_t> allocationCount{0};
+
+/// The number of heap allocations so far.
+static uint64_t allocations() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+RunStats::RunStats()
+    : start(std::chrono::steady_clock::now()), loadEnd(start),
+      lastEmit(start), startAllocations(allocations()),
+      loadAllocations(startAllocations), emitAllocations(startAllocations) {}
+
+void RunStats::loaded() {
+  loadEnd = std::chrono::steady_clock::now();
+  loadAllocations = emitAllocations = allocations();
+}
+
+void RunStats::emitted(std::chrono::system_clock::time_point due) {
+  lastEmit = std::chrono::steady_clock::now();
+  emitAllocations = allocations();
+  const int64_t late =
+      std::max<int64_t>((std::chrono::system_clock::now() - due) /
+                            std::chrono::nanoseconds(1),
+                        0);
+  ++events;
+  latenessSum += late;
+  latenessMax = std::max(latenessMax, late);
+  ++histogram[std::bit_width(static_cast<uint64_t>(late))];
+}
+
+int64_t RunStats::percentile(double p) const {
+  uint64_t seen = 0;
+  for (size_t i = 0; i < histogram.size(); ++i) {
+    seen += histogram[i];
+    if (seen >= p * events)
+      return i == 0 ? 0 : std::min(int64_t(1) << std::min<size_t>(i, 62),
+                                   latenessMax);
+  }
+  return latenessMax;
+}
+
+void RunStats::write(const std::string &file) const {
+  auto seconds = [](auto d) {
+    return std::chrono::duration<double>(d).count();
+  };
+  const double emitSeconds = seconds(lastEmit - loadEnd);
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  std::ostringstream s;
+  s << "{\n"
+    << "  \"events\": " << events << ",\n"
+    << "  \"load_seconds\": " << seconds(loadEnd - start) << ",\n"
+    << "  \"emit_seconds\": " << emitSeconds << ",\n"
+    << "  \"events_per_second\": "
+    << (emitSeconds > 0 ? events / emitSeconds : 0) << ",\n"
+    << "  \"lateness_mean_us\": "
+    << (events > 0 ? latenessSum / events / 1000 : 0) << ",\n"
+    << "  \"lateness_p50_us\": " << percentile(0.5) / 1000.0 << ",\n"
+    << "  \"lateness_p99_us\": " << percentile(0.99) / 1000.0 << ",\n"
+    << "  \"lateness_max_us\": " << latenessMax / 1000.0 << ",\n"
+    << "  \"load_allocations\": " << loadAllocations - startAllocations
+    << ",\n"
+    << "  \"emit_allocations\": " << emitAllocations - loadAllocations
+    << ",\n"
+    << "  \"peak_rss_kb\": " << usage.ru_maxrss << "\n"
+    << "}\n";
+
+  if (file == "-") {
+    std::cerr << s.str();
+    return;
+  }
+  std::ofstream out(file);
+  out << s.str();
+  if (!out) {
+    std::cerr << "Failed to write " << file << ": " << strerror(errno) << "\n";
+    exit(1);
+  }
+}
+
+} // namespace TurboEvents
@@ -0,0 +1,59 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace TurboEvents {
+
+/// Measurements of a run, for the scale tests in test/scale.
+///
+/// Lateness is how long after its due time an event was handed to the
+/// outputs. It is kept in a histogram with power of two buckets, so the
+/// percentiles are upper bounds within a factor of two. Allocations are
+/// counted while loading and emitting, see allocationCount, as unlike
+/// times they do not depend on the machine or the build.
+class RunStats {
+public:
+  /// Constructor, call when the run starts.
+  RunStats();
+
+  /// Note that the inputs have been loaded.
+  void loaded();
+  /// Note that an event due at the given time is being handed to the
+  /// outputs.
+  void emitted(std::chrono::system_clock::time_point due);
+  /// Write the measurements as JSON to file, or standard error for "-".
+  void write(const std::string &file) const;
+
+private:
+  /// Upper bound in nanoseconds of the lateness of fraction p of events.
+  int64_t percentile(double p) const;
+
+  /// When the run started.
+  const std::chrono::steady_clock::time_point start;
+  /// When the inputs were loaded.
+  std::chrono::steady_clock::time_point loadEnd;
+  /// When the last event was emitted.
+  std::chrono::steady_clock::time_point lastEmit;
+  /// Heap allocations when the run started.
+  const uint64_t startAllocations;
+  /// Heap allocations when the inputs were loaded.
+  uint64_t loadAllocations;
+  /// Heap allocations when the last event was emitted.
+  uint64_t emitAllocations;
+  /// Number of events emitted.
+  uint64_t events = 0;
+  /// Sum of the lateness of all events in nanoseconds.
+  double latenessSum = 0;
+  /// Largest lateness in nanoseconds.
+  int64_t latenessMax = 0;
+  /// Number of events with lateness in [2^(i-1), 2^i) nanoseconds,
+  /// bucket 0 holds events that were not late.
+  std::array<uint64_t, 64> histogram{};
+};
+
+} // namespace TurboEvents
+#endif
@@ -0,0 +1,101 @@
+#include "Trace.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+namespace TurboEvents::Trace {
+
+#ifdef TURBOEVENTS_TRACING
+
+std::atomic<bool> enabled(false);
+
+/// A recorded span.
+struct Span {
+  const char *name; ///< Name of the span.
+  int64_t begin;    ///< Start in nanoseconds.
+  int64_t end;      ///< End in nanoseconds.
+};
+
+/// The spans recorded by a thread.
+struct Buffer {
+  std::vector<Span> spans; ///< The spans, in order of ending.
+  uint64_t tid;            ///< Thread number for the trace.
+  uint64_t dropped = 0;    ///< Spans not recorded since the buffer was full.
+};
+
+/// Maximum number of spans per thread, about 400 MB.
+static constexpr size_t maxSpans = size_t(1) << 24;
+
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<Buffer>> buffers;
+static std::string traceFile;
+static int64_t origin;
+
+void record(const char *name, int64_t begin, int64_t end) {
+  thread_local Buffer *buf = nullptr;
+  if (!buf) {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffers.push_back(std::make_unique<Buffer>());
+    buf = buffers.back().get();
+    buf->tid = buffers.size();
+  }
+  if (buf->spans.size() < maxSpans)
+    buf->spans.push_back({name, begin, end});
+  else
+    ++buf->dropped;
+}
+
+void start(std::string file) {
+  traceFile = std::move(file);
+  origin = now();
+  enabled.store(true, std::memory_order_relaxed);
+}
+
+void stop() {
+  if (!enabled.exchange(false)) return;
+  std::ofstream f(traceFile);
+  if (!f) {
+    std::cerr << "Failed to write trace to " << traceFile << "\n";
+    return;
+  }
+  const auto pid = getpid();
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  // Times are in microseconds, keep them to the nanosecond as the default
+  // six significant digits lose precision after a second.
+  f << std::fixed << std::setprecision(3);
+  f << "{\"traceEvents\":[\n";
+  bool first = true;
+  for (auto &buf : buffers) {
+    for (const Span &s : buf->spans) {
+      if (s.begin < origin) continue; // From an earlier recording.
+      f << (first ? "" : ",\n") << "{\"name\":\"" << s.name
+        << "\",\"ph\":\"X\",\"ts\":" << (s.begin - origin) / 1000.0
+        << ",\"dur\":" << (s.end - s.begin) / 1000.0 << ",\"pid\":" << pid
+        << ",\"tid\":" << buf->tid << "}";
+      first = false;
+    }
+    if (buf->dropped)
+      std::cerr << "Trace buffer full, " << buf->dropped
+                << " span(s) were dropped\n";
+    buf->spans.clear();
+    buf->dropped = 0;
+  }
+  f << "\n]}\n";
+}
+
+#else
+
+void start(std::string) {
+  std::cerr << "Tracing is not available, configure with -DTRACING=ON\n";
+}
+
+void stop() {}
+
+#endif
+
+} // namespace TurboEvents::Trace
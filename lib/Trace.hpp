@@ -0,0 +1,92 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/***********************************************************************
+ * Tracing of the run loop and the inputs and outputs.
+ *
+ * TE_TRACE_SCOPE(name) marks the rest of the enclosing scope as a span
+ * called name. When configured with -DTRACING=ON a span does two
+ * things:
+ *
+ *  - It fires the static USDT probes turboevents:name_begin and
+ *    turboevents:name_end, if <sys/sdt.h> is available. These are
+ *    single nops until attached to with perf or bpftrace, e.g.
+ *      bpftrace -e 'usdt:./turboevents:turboevents:trigger_begin {...}'
+ *  - If the in-process recorder has been started, it records the span
+ *    in a per-thread buffer that is written as Chrome trace-event JSON
+ *    (chrome://tracing, Perfetto) when the recorder stops. When the
+ *    recorder is off this costs one relaxed load of a flag.
+ *
+ * Without -DTRACING=ON the macro expands to nothing.
+ * *********************************************************************/
+
+namespace TurboEvents::Trace {
+
+/// Start recording spans, to be written to file by stop().
+void start(std::string file);
+/// Stop recording and write the recorded spans.
+void stop();
+
+#ifdef TURBOEVENTS_TRACING
+
+/// Whether the in-process recorder is running.
+extern std::atomic<bool> enabled;
+
+/// Nanoseconds on the monotonic clock.
+inline int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// Record a span in the buffer of the calling thread.
+void record(const char *name, int64_t begin, int64_t end);
+
+/// A span lasting until the end of the scope.
+template <typename F> class Scope {
+public:
+  /// Constructor
+  Scope(const char *n, F f)
+      : name(n), onEnd(f),
+        begin(enabled.load(std::memory_order_relaxed) ? now() : 0) {}
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+  /// Destructor, ends the span.
+  ~Scope() {
+    onEnd();
+    if (begin) record(name, begin, now());
+  }
+
+private:
+  const char *name;    ///< Name of the span.
+  F onEnd;             ///< Fires the end probe.
+  const int64_t begin; ///< Start of the span, 0 if not recording.
+};
+
+#endif
+
+} // namespace TurboEvents::Trace
+
+#ifdef TURBOEVENTS_TRACING
+#ifdef TURBOEVENTS_HAVE_SDT
+#include <sys/sdt.h>
+#define TE_PROBE(name) DTRACE_PROBE(turboevents, name)
+#else
+#define TE_PROBE(name) static_cast<void>(0)
+#endif
+#define TE_TRACE_CONCAT2(a, b) a##b
+#define TE_TRACE_CONCAT(a, b) TE_TRACE_CONCAT2(a, b)
+#define TE_TRACE_SCOPE(name)                                                   \
+  TE_PROBE(name##_begin);                                                      \
+  ::TurboEvents::Trace::Scope TE_TRACE_CONCAT(teTraceScope, __LINE__)(         \
+      #name, [] { TE_PROBE(name##_end); })
+#else
+#define TE_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
+
+#endif
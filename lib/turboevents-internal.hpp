@@ -1,12 +1,14 @@
 #ifndef TURBOEVENTS_INTERNAL_HPP
 #define TURBOEVENTS_INTERNAL_HPP
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <sys/uio.h>
 #include <variant>
 
 #include "IO/Serializers.hpp"
@@ -20,14 +22,115 @@ extern uint64_t streamNum;
 template <class> inline constexpr bool alwaysFalseV = false;
 
 /// A type for events with time stamps and string payload.
-struct Event {
+///
+/// The payload is only available through gather(), assemble() and
+/// payload(), as subclasses may keep part of it elsewhere.
+class Event {
+public:
   /// Constructor
   Event(std::chrono::system_clock::time_point t, std::string d)
       : time(t), data(d) {}
   /// Virtual destructor
   virtual ~Event() {}
+
+  /// Size of the payload in bytes.
+  virtual size_t size() const { return data.size(); }
+  /// Describe the payload in at most three buffers, return how many.
+  virtual int gather(struct iovec *iov) const {
+    iov[0] = {const_cast<char *>(data.data()), data.size()};
+    return 1;
+  }
+  /// Copy the payload into buf, reusing its storage.
+  virtual void assemble(std::string &buf) const { buf.assign(data); }
+  /// Make a copy of the event at time t with the same payload.
+  virtual std::unique_ptr<Event>
+  copyAt(std::chrono::system_clock::time_point t) const {
+    return std::make_unique<Event>(t, data);
+  }
+  /// Make a copy of the event at time t with the first n bytes of the
+  /// payload, which must not reach a shared part, replaced by prefix.
+  virtual std::unique_ptr<Event>
+  copyWithPrefix(std::chrono::system_clock::time_point t, size_t n,
+                 std::string prefix) const {
+    prefix.append(data, n);
+    return std::make_unique<Event>(t, std::move(prefix));
+  }
+
+  /// Return the payload as a single string.
+  std::string payload() const {
+    std::string buf;
+    assemble(buf);
+    return buf;
+  }
+
   const std::chrono::system_clock::time_point time; ///< Time stamp of event.
-  const std::string data;                           ///< Data of event.
+
+protected:
+  const std::string data; ///< Data of event, or part of it in subclasses.
+};
+
+/// An event with part of its payload shared with other events, for
+/// instance the context common to all events of an XML stream.
+///
+/// The payload is data with *shared spliced in at sharedPos. Sharing
+/// makes the event larger, so it only saves memory when the shared
+/// part is long enough, see saves().
+class SharedPartEvent : public Event {
+public:
+  /// Constructor
+  SharedPartEvent(std::chrono::system_clock::time_point t, std::string d,
+                  std::shared_ptr<const std::string> s, uint32_t pos)
+      : Event(t, std::move(d)), sharedPos(pos), shared(std::move(s)) {}
+
+  size_t size() const override { return data.size() + shared->size(); }
+  int gather(struct iovec *iov) const override {
+    char *d = const_cast<char *>(data.data());
+    iov[0] = {d, sharedPos};
+    iov[1] = {const_cast<char *>(shared->data()), shared->size()};
+    iov[2] = {d + sharedPos, data.size() - sharedPos};
+    return 3;
+  }
+  void assemble(std::string &buf) const override {
+    buf.assign(data, 0, sharedPos);
+    buf += *shared;
+    buf.append(data, sharedPos);
+  }
+  std::unique_ptr<Event>
+  copyAt(std::chrono::system_clock::time_point t) const override {
+    return std::make_unique<SharedPartEvent>(t, data, shared, sharedPos);
+  }
+  std::unique_ptr<Event>
+  copyWithPrefix(std::chrono::system_clock::time_point t, size_t n,
+                 std::string prefix) const override {
+    const uint32_t pos = sharedPos - n + prefix.size();
+    prefix.append(data, n);
+    return std::make_unique<SharedPartEvent>(t, std::move(prefix), shared,
+                                             pos);
+  }
+
+  /// Whether sharing a part of sharedSize bytes with a payload of
+  /// dataSize bytes takes no more memory than copying it into the
+  /// payload. The shared part is allocated once for all events sharing
+  /// it and is not counted. On a tie the part is shared, which also
+  /// saves copying it.
+  static bool saves(size_t dataSize, size_t sharedSize) {
+    return footprint(sizeof(SharedPartEvent), dataSize) <=
+           footprint(sizeof(Event), dataSize + sharedSize);
+  }
+  /// Estimated heap memory of an event object of the given size with a
+  /// payload of n bytes, in malloc chunks of 16 bytes with 8 bytes of
+  /// overhead as in glibc. Short payloads are kept in the std::string.
+  static size_t footprint(size_t object, size_t n) {
+    auto chunk = [](size_t bytes) {
+      return std::max<size_t>(32, (bytes + 8 + 15) & ~size_t(15));
+    };
+    return chunk(object) + (n > std::string().capacity() ? chunk(n + 1) : 0);
+  }
+
+private:
+  const uint32_t sharedPos; ///< Position in data of the shared part.
+  /// Part of the payload shared with other events.
+  const std::shared_ptr<const std::string> shared;
 };
 
 /// Various configuration of the system.
@@ -36,14 +139,15 @@ public:
   /// Constructor
   Config(char separator, std::chrono::system_clock::time_point t,
          bool timeshift)
-      : start(t), tshift(timeshift), serializer(JoinFormat(separator)) {}
+      : start(t), tshift(timeshift), sep(separator),
+        serializer(JoinFormat(separator)) {}
 
   /// Serialize arguments and make an event.
   template <typename... Args>
   std::unique_ptr<Event> makeEvent(std::chrono::system_clock::time_point t,
                                    Args &&...args) {
     return std::visit(
-        [&t, &args...](auto &&arg) {
+        [this, &t, &args...](auto &&arg) {
           // Update this function when adding a new type of serializer.
           //
           // This is just an exhaustive switch over all types in the
@@ -60,10 +164,34 @@ public:
         serializer);
   }
 
-  /// Start time of the system.
-  const std::chrono::system_clock::time_point start;
+  /// Make an event of an already serialized payload, such as a row of a
+  /// delimited file.
+  std::unique_ptr<Event>
+  makeDelimitedEvent(std::chrono::system_clock::time_point t,
+                     std::string data) {
+    return std::make_unique<Event>(t, std::move(data));
+  }
+
+  /// Make an event of a serialized payload with shared spliced in at pos,
+  /// sharing it only if that is smaller than copying it into the payload.
+  std::unique_ptr<Event>
+  makeSharedEvent(std::chrono::system_clock::time_point t, std::string data,
+                  const std::shared_ptr<const std::string> &shared,
+                  uint32_t pos) {
+    if (SharedPartEvent::saves(data.size(), shared->size()))
+      return std::make_unique<SharedPartEvent>(t, std::move(data), shared,
+                                               pos);
+    data.insert(pos, *shared);
+    return makeDelimitedEvent(t, std::move(data));
+  }
+
+  /// Start time of the system, agreed with the other processes of a
+  /// partitioned run when the run begins.
+  std::chrono::system_clock::time_point start;
   /// Whether to time shift.
   const bool tshift;
+  /// Separator between the fields of serialized events.
+  const char sep;
 
 private:
   std::variant<JoinFormat> serializer; ///< The serializer to use.
@@ -73,8 +201,9 @@ private:
 /// order
 class EventStream {
 public:
-  /// Constructor
-  EventStream() : id(streamNum++), time(std::chrono::system_clock::now()) {}
+  /// Constructor, the fields of the payloads are separated by s.
+  EventStream(char s)
+      : id(streamNum++), time(std::chrono::system_clock::now()), sep(s) {}
   /// Virtual destructor
   virtual ~EventStream() {}
   /// Get the current event.
@@ -82,10 +211,21 @@ public:
 
   /// Try to generate an event, return true if successful.
   virtual bool generate(Config &cfg) = 0;
+  /// Restart the stream from its first event, with all times moved by
+  /// offset from the first pass, return false if not supported.
+  virtual bool rewind(std::chrono::nanoseconds) { return false; }
+  /// Make a new stream over the same events, sharing their storage, with
+  /// all times moved by offset, return nullptr if not supported.
+  virtual std::unique_ptr<EventStream> replicate(std::chrono::nanoseconds) {
+    return nullptr;
+  }
   /// Identity for deterministic ordering of events with same times.
   const uint64_t id;
   /// The time stamp of the current event.
   std::chrono::system_clock::time_point time;
+  /// Separator between the fields of the payloads, which depends on the
+  /// input, such as the delimiter of a CSV file.
+  const char sep;
 };
 
 /// A class encapsulating an input, such as a file
@@ -111,6 +251,11 @@ public:
 
   /// Function to call when the time is right
   virtual void trigger(Event &e) = 0;
+  /// Function to call when the time is right for an event with fields
+  /// separated by sep, overridden by outputs that look at the fields.
+  virtual void triggerDelimited(Event &e, char) { trigger(e); }
+  /// Function to call when the run has ended
+  virtual void flush() {}
 };
 
 } // namespace TurboEvents
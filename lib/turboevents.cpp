@@ -1,9 +1,22 @@
 #include "turboevents.hpp"
+#include "IO/CSVInput.hpp"
 #include "IO/ContainerInput.hpp"
 #include "IO/CountDownInput.hpp"
+#include "IO/FileOutput.hpp"
 #include "IO/KafkaOutput.hpp"
 #include "IO/PrintOutput.hpp"
+#include "IO/ReplicatedInput.hpp"
+#include "IO/SharedMemoryOutput.hpp"
 #include "IO/XMLInput.hpp"
+#include "InjectionSocket.hpp"
+#include "MPSCQueue.hpp"
+#include "Pacing.hpp"
+#include "Pipeline.hpp"
+#include "Rendezvous.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <charconv>
 #include <pybind11/chrono.h>
 #include <pybind11/embed.h>
 #include <pybind11/stl.h>
@@ -17,6 +30,9 @@ namespace TurboEvents {
 
 uint64_t streamNum = 0;
 
+/// How often run() looks for injected events while waiting.
+static constexpr std::chrono::milliseconds injectionPoll(1);
+
 /// The real TurboEvents implementation.
 class TurboEventsImpl : public Config, public TurboEvents {
 public:
@@ -28,26 +44,76 @@ public:
 
   void createContainerInput() override;
   void createCountDownInput(int m, int i) override;
+  void createCSVFileInput(const char *name, char delim, int tsCol,
+                          std::string tsFmt, int keyCol, bool header) override;
   void createXMLFileInput(const char *name,
                           std::vector<std::vector<std::string>> &ctrl) override;
+  void setReplicas(int count, int idField, double offsetSeconds,
+                   double jitterSeconds) override;
 
   void addKafkaOutput(std::string brokers, std::string caLocation,
                       std::string certLocation, std::string keyLocation,
                       std::string keyPwd, std::string topic) override;
+  void addFileOutput(std::string name) override;
   void addPrintOutput() override;
+  void addSharedMemoryOutput(std::string name, uint64_t slots,
+                             uint32_t slotSize, uint32_t readers) override;
+  void addOperator(std::string spec) override;
 
   void run(double scale) override;
+  void setLoop(int count, double gapSeconds) override;
+  void setMaxGap(double seconds) override;
+  void setRateProfile(std::vector<std::pair<double, double>> profile) override;
+  void setPartition(int rank, int count, std::string dir,
+                    std::string run) override;
+  void setTraceFile(std::string file) override;
+  void setStatsFile(std::string file) override;
 
   void addEvent(std::chrono::system_clock::time_point time,
                 std::string data) override;
+  void enableInjection(std::string socketPath) override;
+  void injectEvent(std::chrono::system_clock::time_point time,
+                   std::string data) override;
 
 private:
+  /// Inject an event received on the injection socket.
+  void injectLine(std::string_view line);
+
   /// The outputs for the run.
   std::vector<std::unique_ptr<Output>> outputs;
   /// The input sources for the run.
   std::vector<std::unique_ptr<Input>> inputs;
   /// Intermediate events for createContainerInput.
   std::vector<std::unique_ptr<Event>> events;
+  /// Rate profile for the run, empty to pace by time stamps.
+  std::vector<std::pair<double, double>> rateProfile;
+  /// Rank of this process in a partitioned run.
+  int partitionRank = 0;
+  /// Number of processes in a partitioned run, 1 if not partitioned.
+  int partitionCount = 1;
+  /// Directory to coordinate a partitioned run through.
+  std::string rendezvousDir;
+  /// Identifies a partitioned run among the files in rendezvousDir.
+  std::string runId;
+  /// File to write a Chrome trace of the run to, if any.
+  std::string traceFile;
+  /// File to write the measurements of the run to, if any.
+  std::string statsFile;
+  /// Number of passes over the inputs, 0 to loop until stopped.
+  int loopCount = 1;
+  /// Gap between the last event of a pass and the first of the next.
+  std::chrono::nanoseconds loopGap{0};
+  /// Longest gap between consecutive events to pace, 0 for no limit.
+  std::chrono::nanoseconds maxGap{0};
+  /// Events injected by other threads, merged into the run by time.
+  MPSCQueue<std::unique_ptr<Event>> injected;
+  /// Events injected on the socket, with the wall-clock time they are
+  /// due at as their time, so that they are not paced.
+  MPSCQueue<std::unique_ptr<Event>> injectedAt;
+  /// Whether run() wakes up to look for injected events while waiting.
+  bool injection = false;
+  /// Unix domain socket to receive injected events on, if any.
+  std::string injectionSocket;
 };
 
 PYBIND11_EMBEDDED_MODULE(TurboEvents, m) {
@@ -55,11 +121,26 @@ PYBIND11_EMBEDDED_MODULE(TurboEvents, m) {
       .def(py::init<char, bool>())
       .def("createContainerInput", &TurboEventsImpl::createContainerInput)
       .def("createCountDownInput", &TurboEventsImpl::createCountDownInput)
+      .def("createCSVFileInput", &TurboEventsImpl::createCSVFileInput)
       .def("createXMLFileInput", &TurboEventsImpl::createXMLFileInput)
+      .def("setReplicas", &TurboEventsImpl::setReplicas)
       .def("addKafkaOutput", &TurboEventsImpl::addKafkaOutput)
+      .def("addFileOutput", &TurboEventsImpl::addFileOutput)
       .def("addPrintOutput", &TurboEventsImpl::addPrintOutput)
-      .def("run", &TurboEventsImpl::run)
-      .def("addEvent", &TurboEventsImpl::addEvent);
+      .def("addSharedMemoryOutput", &TurboEventsImpl::addSharedMemoryOutput)
+      .def("addOperator", &TurboEventsImpl::addOperator)
+      .def("run", &TurboEventsImpl::run,
+           py::call_guard<py::gil_scoped_release>())
+      .def("setLoop", &TurboEventsImpl::setLoop)
+      .def("setMaxGap", &TurboEventsImpl::setMaxGap)
+      .def("setRateProfile", &TurboEventsImpl::setRateProfile)
+      .def("setPartition", &TurboEventsImpl::setPartition)
+      .def("setTraceFile", &TurboEventsImpl::setTraceFile)
+      .def("setStatsFile", &TurboEventsImpl::setStatsFile)
+      .def("addEvent", &TurboEventsImpl::addEvent)
+      .def("enableInjection", &TurboEventsImpl::enableInjection)
+      .def("injectEvent", &TurboEventsImpl::injectEvent,
+           py::call_guard<py::gil_scoped_release>());
 }
 
 TurboEvents::TurboEvents() {
@@ -74,11 +155,18 @@ std::unique_ptr<TurboEvents> TurboEvents::create(char sep, bool timeshift) {
 }
 
 void TurboEventsImpl::createContainerInput() {
-  inputs.push_back(std::make_unique<ContainerInput>(std::move(events)));
+  inputs.push_back(std::make_unique<ContainerInput>(std::move(events), sep));
 }
 
 void TurboEventsImpl::createCountDownInput(int m, int i) {
-  inputs.push_back(std::make_unique<CountDownInput>(m, i));
+  inputs.push_back(std::make_unique<CountDownInput>(m, i, sep));
+}
+
+void TurboEventsImpl::createCSVFileInput(const char *name, char delim,
+                                         int tsCol, std::string tsFmt,
+                                         int keyCol, bool header) {
+  inputs.push_back(std::make_unique<CSVFileInput>(name, delim, tsCol, tsFmt,
+                                                  keyCol, header));
 }
 
 void TurboEventsImpl::createXMLFileInput(
@@ -86,6 +174,22 @@ void TurboEventsImpl::createXMLFileInput(
   inputs.push_back(std::make_unique<XMLFileInput>(name, ctrl));
 }
 
+void TurboEventsImpl::setReplicas(int count, int idField, double offsetSeconds,
+                                  double jitterSeconds) {
+  if (inputs.empty() || count < 1 || jitterSeconds < 0) {
+    std::cerr << "Bad replicas " << count << " with jitter " << jitterSeconds
+              << "\n";
+    exit(1);
+  }
+  auto seconds = [](double s) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(s));
+  };
+  inputs.back() = std::make_unique<ReplicatedInput>(
+      std::move(inputs.back()), count, idField, seconds(offsetSeconds),
+      seconds(jitterSeconds));
+}
+
 void TurboEventsImpl::addKafkaOutput(std::string brokers,
                                      std::string caLocation,
                                      std::string certLocation,
@@ -95,10 +199,36 @@ void TurboEventsImpl::addKafkaOutput(std::string brokers,
       brokers, caLocation, certLocation, keyLocation, keyPwd, topic));
 }
 
+void TurboEventsImpl::addFileOutput(std::string name) {
+  outputs.push_back(std::make_unique<FileOutput>(name));
+}
+
 void TurboEventsImpl::addPrintOutput() {
   outputs.push_back(std::make_unique<PrintOutput>());
 }
 
+void TurboEventsImpl::addSharedMemoryOutput(std::string name, uint64_t slots,
+                                            uint32_t slotSize,
+                                            uint32_t readers) {
+  outputs.push_back(
+      std::make_unique<SharedMemoryOutput>(name, slots, slotSize, readers));
+}
+
+void TurboEventsImpl::addOperator(std::string spec) {
+  if (outputs.empty()) {
+    std::cerr << "No output to add operator " << spec << " to\n";
+    exit(1);
+  }
+  auto *p = dynamic_cast<PipelineOutput *>(outputs.back().get());
+  if (!p) {
+    auto wrapped =
+        std::make_unique<PipelineOutput>(std::move(outputs.back()), sep);
+    p = wrapped.get();
+    outputs.back() = std::move(wrapped);
+  }
+  p->add(makeOperator(spec));
+}
+
 void TurboEvents::runScript(std::string &file) {
   py::scoped_interpreter guard{};
 
@@ -123,21 +253,227 @@ void TurboEventsImpl::run(double scale) {
   std::priority_queue<EventStream *, std::vector<EventStream *>,
                       decltype(greaterES)>
       q(greaterES);
-  auto push = [&q, this](EventStream *s) {
-    if (s->generate(*this)) q.push(s);
+  if (!traceFile.empty()) Trace::start(traceFile);
+  // In a partitioned run, agree on the start before the inputs use it.
+  std::unique_ptr<Rendezvous> rv;
+  if (partitionCount > 1) {
+    rv = std::make_unique<Rendezvous>(rendezvousDir, runId, partitionRank,
+                                      partitionCount);
+    start = rv->join();
+  }
+  std::unique_ptr<RunStats> stats;
+  if (!statsFile.empty()) stats = std::make_unique<RunStats>();
+  auto generate = [this](EventStream *s) {
+    TE_TRACE_SCOPE(generate);
+    return s->generate(*this);
+  };
+  // Every process of a partitioned run merges all streams, so that gaps,
+  // rates and loop periods are those of the whole run, and only emits
+  // the events of its own streams.
+  auto push = [&q, &generate](EventStream *s) {
+    if (generate(s)) q.push(s);
   };
   for (auto &input : inputs) input->addStreams(*this, push);
-  const auto strt = start;
-  while (!q.empty()) {
-    EventStream *es = q.top();
-    Event *e = es->getEvent();
-    std::this_thread::sleep_until(strt + scale * (e->time - strt));
-    for (auto &o : outputs) o->trigger(*e);
-    q.pop();
-    if (es->generate(*this))
-      q.push(es); // Push the stream back on the queue if there are more events
+  if (stats) stats->loaded();
+  // Begin together once the slowest process has loaded, with the time
+  // stamps still relative to the agreed start.
+  auto begin = start;
+  if (rv) {
+    begin = rv->ready();
+    std::this_thread::sleep_until(begin);
+  }
+  std::unique_ptr<Pacer> pacer;
+  if (rateProfile.empty())
+    pacer = std::make_unique<ScalePacer>(start, begin, scale);
+  else
+    pacer = std::make_unique<RatePacer>(rateProfile);
+  if (maxGap.count() > 0)
+    pacer = std::make_unique<GapPacer>(std::move(pacer), maxGap);
+  // Streams that have ended, to be rewound for the next pass.
+  std::vector<EventStream *> ended;
+  // Times of the first and last events of the first pass, over all
+  // streams also in a partitioned run.
+  std::chrono::system_clock::time_point first, last;
+  if (!q.empty()) first = q.top()->time;
+  std::chrono::nanoseconds period(0);
+  // Injected events received so far, heaps ordered by time.
+  std::vector<std::unique_ptr<Event>> pending, pendingAt;
+  auto later = [](const auto &a, const auto &b) { return a->time > b->time; };
+  std::unique_ptr<InjectionSocket> socket;
+  if (!injectionSocket.empty() && partitionRank == 0)
+    socket = std::make_unique<InjectionSocket>(
+        injectionSocket, [this](std::string_view line) { injectLine(line); });
+  for (int pass = 1;; ++pass) {
+    while (!q.empty()) {
+      for (std::unique_ptr<Event> ie; injected.pop(ie);) {
+        pending.push_back(std::move(ie));
+        std::push_heap(pending.begin(), pending.end(), later);
+      }
+      for (std::unique_ptr<Event> ie; injectedAt.pop(ie);) {
+        pendingAt.push_back(std::move(ie));
+        std::push_heap(pendingAt.begin(), pendingAt.end(), later);
+      }
+      EventStream *es = q.top();
+      Event *e = es->getEvent();
+      // Injected events go before stream events with the same time.
+      bool isInjected = !pending.empty() && pending.front()->time <= e->time;
+      if (isInjected) e = pending.front().get();
+      auto due = pacer->due(e->time);
+      // Events injected at a wall-clock time are due at that time.
+      const bool isInjectedAt =
+          !pendingAt.empty() && pendingAt.front()->time <= due;
+      if (isInjectedAt) {
+        isInjected = false;
+        e = pendingAt.front().get();
+        due = e->time;
+      }
+      // Injected events only reach rank 0 of a partitioned run.
+      const bool mine =
+          isInjected || isInjectedAt || !rv || rv->owns(es->id);
+      if (mine) {
+        if (injection &&
+            due - std::chrono::system_clock::now() > injectionPoll) {
+          // Wake up regularly to look for injected events due earlier.
+          TE_TRACE_SCOPE(sleep);
+          std::this_thread::sleep_for(injectionPoll);
+          continue;
+        }
+        {
+          TE_TRACE_SCOPE(sleep);
+          std::this_thread::sleep_until(due);
+        }
+        // Before triggering, so that the time the outputs take is not
+        // counted as lateness.
+        if (stats) stats->emitted(due);
+        // Injected events are serialized like those of makeEvent().
+        const char delim = isInjected || isInjectedAt ? sep : es->sep;
+        for (auto &o : outputs) {
+          TE_TRACE_SCOPE(trigger);
+          o->triggerDelimited(*e, delim);
+        }
+      }
+      // Injected events are overlaid on the replay without moving it, so
+      // that all processes of a partitioned run pace alike.
+      if (isInjected || isInjectedAt) {
+        auto &heap = isInjected ? pending : pendingAt;
+        std::pop_heap(heap.begin(), heap.end(), later);
+        heap.pop_back();
+        continue;
+      }
+      pacer->emitted();
+      if (pass == 1) last = e->time;
+      {
+        TE_TRACE_SCOPE(merge);
+        q.pop();
+      }
+      // Push the stream back on the queue if there are more events.
+      if (generate(es)) {
+        TE_TRACE_SCOPE(merge);
+        q.push(es);
+      } else if (loopCount != 1)
+        ended.push_back(es);
+    }
+    if (pass == loopCount || ended.empty()) break;
+
+    // Replay the streams that can be rewound, each pass shifted by the
+    // span of the first pass plus the gap.
+    if (pass == 1) period = last - first + loopGap;
+    for (EventStream *s : ended)
+      if (s->rewind(pass * period) && generate(s)) q.push(s);
+    ended.clear();
   }
+  // The run ends with the replay, later injected events are dropped.
+  socket.reset();
+  size_t dropped = pending.size() + pendingAt.size();
+  for (std::unique_ptr<Event> ie; injected.pop(ie);) ++dropped;
+  for (std::unique_ptr<Event> ie; injectedAt.pop(ie);) ++dropped;
+  if (dropped > 0)
+    std::cerr << "Warning: dropped " << dropped
+              << " injected events after the end of the run\n";
+  for (auto &o : outputs) o->flush();
+  pacer->finish();
   for (auto &input : inputs) input->finish();
+  if (stats) stats->write(statsFile);
+  Trace::stop();
+}
+
+void TurboEventsImpl::enableInjection(std::string socketPath) {
+  injection = true;
+  injectionSocket = std::move(socketPath);
+}
+
+void TurboEventsImpl::injectEvent(std::chrono::system_clock::time_point time,
+                                  std::string data) {
+  // The processes of a partitioned run typically run the same script,
+  // rank 0 emits the injected events for all of them.
+  if (partitionRank != 0) return;
+  injected.push(makeEvent(time, data));
+}
+
+void TurboEventsImpl::injectLine(std::string_view line) {
+  auto time = std::chrono::system_clock::now();
+  if (!line.empty() && line[0] == '@') {
+    // An explicit wall-clock time in milliseconds since the epoch.
+    const size_t space = std::min(line.find(' '), line.size());
+    int64_t ms;
+    auto [end, ec] = std::from_chars(line.data() + 1, line.data() + space, ms);
+    if (ec != std::errc() || end != line.data() + space) {
+      std::cerr << "Bad injected event: " << line << "\n";
+      return;
+    }
+    time = std::chrono::system_clock::time_point(std::chrono::milliseconds(ms));
+    line.remove_prefix(std::min(space + 1, line.size()));
+  }
+  // The socket is only opened on rank 0.
+  injectedAt.push(makeEvent(time, std::string(line)));
+}
+
+void TurboEventsImpl::setLoop(int count, double gapSeconds) {
+  if (count < 0 || gapSeconds < 0) {
+    std::cerr << "Bad loop " << count << " with gap " << gapSeconds << "\n";
+    exit(1);
+  }
+  loopCount = count;
+  loopGap = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(gapSeconds));
+}
+
+void TurboEventsImpl::setMaxGap(double seconds) {
+  if (seconds < 0) {
+    std::cerr << "Bad maximum gap " << seconds << "\n";
+    exit(1);
+  }
+  maxGap = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(seconds));
+}
+
+void TurboEventsImpl::setStatsFile(std::string file) {
+  statsFile = std::move(file);
+}
+
+void TurboEventsImpl::setTraceFile(std::string file) {
+  traceFile = std::move(file);
+}
+
+void TurboEventsImpl::setPartition(int rank, int count, std::string dir,
+                                   std::string run) {
+  if (count < 1 || rank < 0 || rank >= count) {
+    std::cerr << "Bad partition " << rank << " of " << count << "\n";
+    exit(1);
+  }
+  if (count > 1 && run.empty()) {
+    std::cerr << "Partitioned runs need a run id\n";
+    exit(1);
+  }
+  partitionRank = rank;
+  partitionCount = count;
+  rendezvousDir = std::move(dir);
+  runId = std::move(run);
+}
+
+void TurboEventsImpl::setRateProfile(
+    std::vector<std::pair<double, double>> profile) {
+  rateProfile = std::move(profile);
 }
 
 void TurboEventsImpl::addEvent(std::chrono::system_clock::time_point time,
@@ -1,9 +1,13 @@
 #include "turboevents.hpp"
 
+#include <cstdlib>
+#include <functional>
 #include <gflags/gflags.h>
 #include <iostream>
+#include <new>
 #include <sstream>
 #include <string>
+#include <vector>
 
 static bool validateSeparator(const char *flag, const std::string &value) {
   if (value.size() == 1) return true;
@@ -16,6 +20,9 @@ DEFINE_string(script, "", "file name for Python script");
 DEFINE_bool(print, false, "print the Python commands and exit");
 DEFINE_string(input, "", "comma-separated list of algorithmic input streams");
 DEFINE_string(output, "print", "comma-separated list of outputs");
+DEFINE_string(pipeline, "",
+              "semicolon-separated operator pipelines for the outputs, in "
+              "order, each a |-separated list such as sample:0.1|dup:0.01");
 DEFINE_string(separator, ",", "separator for serialization");
 DEFINE_validator(separator, &validateSeparator);
 DEFINE_bool(timeshift, false,
@@ -23,47 +30,186 @@ DEFINE_bool(timeshift, false,
 DEFINE_double(scale, 1.0,
               "scaling factor for intervals between events, less than 1 "
               "accelerates delivery");
+DEFINE_double(max_gap, 0.0,
+              "longest gap between consecutive events in seconds to wait "
+              "through, longer gaps are cut to this, 0 for no limit");
+DEFINE_int32(loop, 1,
+             "number of times to replay the inputs, 0 to loop until stopped");
+DEFINE_double(loop_gap, 0.0,
+              "seconds between the last event of a replay and the first of "
+              "the next");
+DEFINE_int32(replicas, 1,
+             "number of copies of each stream of the file inputs to emit");
+DEFINE_int32(replica_id_field, 1,
+             "field of the payloads to suffix with the copy number, -1 for "
+             "none");
+DEFINE_double(replica_offset, 0.0, "seconds between consecutive copies");
+DEFINE_double(replica_jitter, 0.0,
+              "maximum random seconds added to the offset of each copy");
+DEFINE_int32(partition_count, 1,
+             "number of processes sharing the streams of the run");
+DEFINE_int32(partition_rank, 0, "which of the processes this is, from 0");
+DEFINE_string(rendezvous, "/tmp/turboevents-rendezvous",
+              "directory where partitioned processes agree on a start time");
+DEFINE_string(run_id, "",
+              "identifier shared by the processes of a partitioned run, "
+              "distinct for each run");
+DEFINE_string(inject_socket, "",
+              "Unix domain socket to receive events to inject into the run "
+              "on, one per line, optionally prefixed by @<ms since epoch>");
+DEFINE_string(stats_file, "",
+              "write measurements of the run as JSON to this file, - for "
+              "standard error");
+DEFINE_string(trace_file, "",
+              "write a Chrome trace of the run to this file, requires a "
+              "build configured with -DTRACING=ON");
+DEFINE_string(rate, "",
+              "emit events at a fixed rate (events/s) or along a ramp of "
+              "comma-separated seconds:rate points, overrides scale");
 
 // IO parameters, sorted alphabetically.
+DEFINE_string(file_output, "events.out", "file for the file output");
 DEFINE_string(kafka_brokers, "localhost",
-              "comma-separated list of kafka brokers");
+              "comma-separated list of kafka brokers, or mock for an "
+              "in-process mock cluster");
 DEFINE_string(kafka_ca_file, "", "path to ca file");
 DEFINE_string(kafka_certificate_file, "", "path to certificate file");
 DEFINE_string(kafka_key_file, "", "path to key file");
 DEFINE_string(kafka_key_password, "", "password for the key file");
 DEFINE_string(kafka_topic, "measurements", "topic to send kafka messages as");
+DEFINE_string(shm_name, "/turboevents", "name of shared memory ring");
+DEFINE_uint64(shm_slots, 65536,
+              "number of slots in shared memory ring, a power of two");
+DEFINE_uint32(shm_slot_size, 256, "maximum payload bytes per ring slot");
+DEFINE_uint32(shm_readers, 0,
+              "number of ring readers to wait for before the run and to "
+              "detach after it");
+DEFINE_int32(csv_key_column, -1,
+             "column splitting csv rows into streams, -1 for a single stream");
+DEFINE_bool(csv_header, false, "whether csv files start with a header row");
+DEFINE_int32(csv_ts_column, 0, "column of the time stamp in csv files");
+DEFINE_string(csv_ts_format, "%d-%m-%Y %H:%M:%S",
+              "strptime format of csv time stamps, or ms for epoch "
+              "milliseconds");
 DEFINE_string(xml_ctrl, "patient:id/glucose_level/event:ts:value",
               "what to extract from xml file");
 
+// Count heap allocations for --stats_file. All the unaligned forms of new
+// and delete are replaced together so that they pair up, also with the
+// sanitizers, which check that memory is freed the way it was allocated.
+void *operator new(std::size_t n) {
+  TurboEvents::allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void *operator new[](std::size_t n) { return operator new(n); }
+void *operator new(std::size_t n, const std::nothrow_t &) noexcept {
+  TurboEvents::allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(n ? n : 1);
+}
+void *operator new[](std::size_t n, const std::nothrow_t &t) noexcept {
+  return operator new(n, t);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  std::free(p);
+}
+
+/// The configuration from the command line, both as calls on a
+/// TurboEvents object and as the equivalent Python program for --print.
+class Commands {
+public:
+  /// A call on the TurboEvents object.
+  using Step = std::function<void(TurboEvents::TurboEvents &)>;
+
+  /// Add a step, as a line of Python and as the corresponding call.
+  void add(std::string line, Step step) {
+    python += line + "\n";
+    steps.push_back(std::move(step));
+  }
+
+  /// The Python program, excluding the final call to run().
+  std::string python;
+  /// The calls to make before running.
+  std::vector<Step> steps;
+};
+
 int main(int argc, char **argv) {
   gflags::SetUsageMessage("fast event generator");
   gflags::SetVersionString("0.1");
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
-  std::string cmds("import TurboEvents\n");
+  Commands cmds;
   std::string tsArg = FLAGS_timeshift ? "True" : "False";
-  cmds +=
-      "t = TurboEvents.TurboEvents('" + FLAGS_separator + "', " + tsArg + ")\n";
+  cmds.python = "import TurboEvents\n"
+                "t = TurboEvents.TurboEvents('" +
+                FLAGS_separator + "', " + tsArg + ")\n";
 
-  { // Deal with the output flag.
+  { // Deal with the output and pipeline flags.
     std::istringstream iss(FLAGS_output);
+    std::istringstream pipelines(FLAGS_pipeline);
     std::string output;
     while (std::getline(iss, output, ',')) {
       if (output == "kafka")
-        cmds += "t.addKafkaOutput('" + FLAGS_kafka_brokers + "', '" +
-                FLAGS_kafka_ca_file + "', '" + FLAGS_kafka_certificate_file +
-                "', '" + FLAGS_kafka_key_file + "', '" +
-                FLAGS_kafka_key_password + "', '" + FLAGS_kafka_topic + "')\n";
+        cmds.add("t.addKafkaOutput('" + FLAGS_kafka_brokers + "', '" +
+                     FLAGS_kafka_ca_file + "', '" +
+                     FLAGS_kafka_certificate_file + "', '" +
+                     FLAGS_kafka_key_file + "', '" + FLAGS_kafka_key_password +
+                     "', '" + FLAGS_kafka_topic + "')",
+                 [](auto &t) {
+                   t.addKafkaOutput(FLAGS_kafka_brokers, FLAGS_kafka_ca_file,
+                                    FLAGS_kafka_certificate_file,
+                                    FLAGS_kafka_key_file,
+                                    FLAGS_kafka_key_password,
+                                    FLAGS_kafka_topic);
+                 });
+      else if (output == "file")
+        cmds.add("t.addFileOutput('" + FLAGS_file_output + "')",
+                 [](auto &t) { t.addFileOutput(FLAGS_file_output); });
       else if (output == "print")
-        cmds += "t.addPrintOutput()\n";
+        cmds.add("t.addPrintOutput()", [](auto &t) { t.addPrintOutput(); });
+      else if (output == "shm")
+        cmds.add("t.addSharedMemoryOutput('" + FLAGS_shm_name + "', " +
+                     std::to_string(FLAGS_shm_slots) + ", " +
+                     std::to_string(FLAGS_shm_slot_size) + ", " +
+                     std::to_string(FLAGS_shm_readers) + ")",
+                 [](auto &t) {
+                   t.addSharedMemoryOutput(FLAGS_shm_name, FLAGS_shm_slots,
+                                           FLAGS_shm_slot_size,
+                                           FLAGS_shm_readers);
+                 });
       else {
         std::cerr << "Unknown output: " << output << "\n";
         exit(1);
       }
+      std::string pipeline;
+      std::getline(pipelines, pipeline, ';');
+      std::istringstream ops(pipeline);
+      for (std::string op; std::getline(ops, op, '|');)
+        cmds.add("t.addOperator('" + op + "')",
+                 [op](auto &t) { t.addOperator(op); });
     }
   }
 
-  { // Deal with the xml_ctrl flag and corresponding XML inputs.
+  // File inputs are CSV, TSV or XML depending on their extension,
+  // possibly followed by the extension of a compression format.
+  auto hasExt = [](const std::string &f, const std::string &ext) {
+    for (std::string compressed : {"", ".gz", ".zst"}) {
+      std::string e = ext + compressed;
+      if (f.size() > e.size() &&
+          f.compare(f.size() - e.size(), e.size(), e) == 0)
+        return true;
+    }
+    return false;
+  };
+
+  { // Deal with the xml_ctrl flag and the file inputs.
     std::vector<std::vector<std::string>> xmlCtrl;
     std::istringstream iss(FLAGS_xml_ctrl);
     std::string item;
@@ -75,13 +221,43 @@ int main(int argc, char **argv) {
       xmlCtrl.push_back(xmlCtrl2);
     }
     for (int i = 1; i < argc; ++i) {
-      cmds += "t.createXMLFileInput('" + std::string(argv[i]) + "', [";
-      for (auto &ctrl : xmlCtrl) {
-        cmds += "[";
-        for (auto &ctrl2 : ctrl) cmds += "'" + ctrl2 + "', ";
-        cmds += "], ";
+      std::string file(argv[i]);
+      if (hasExt(file, ".csv") || hasExt(file, ".tsv")) {
+        const bool tsv = hasExt(file, ".tsv");
+        cmds.add("t.createCSVFileInput('" + file + "', '" +
+                     (tsv ? "\\t" : ",") + "', " +
+                     std::to_string(FLAGS_csv_ts_column) + ", '" +
+                     FLAGS_csv_ts_format + "', " +
+                     std::to_string(FLAGS_csv_key_column) + ", " +
+                     (FLAGS_csv_header ? "True" : "False") + ")",
+                 [file, tsv](auto &t) {
+                   t.createCSVFileInput(file.c_str(), tsv ? '\t' : ',',
+                                        FLAGS_csv_ts_column,
+                                        FLAGS_csv_ts_format,
+                                        FLAGS_csv_key_column,
+                                        FLAGS_csv_header);
+                 });
+      } else {
+        std::string line = "t.createXMLFileInput('" + file + "', [";
+        for (auto &ctrl : xmlCtrl) {
+          line += "[";
+          for (auto &ctrl2 : ctrl) line += "'" + ctrl2 + "', ";
+          line += "], ";
+        }
+        line += "])";
+        cmds.add(line, [file, xmlCtrl](auto &t) mutable {
+          t.createXMLFileInput(file.c_str(), xmlCtrl);
+        });
       }
-      cmds += "])\n";
+      if (FLAGS_replicas > 1)
+        cmds.add("t.setReplicas(" + std::to_string(FLAGS_replicas) + ", " +
+                     std::to_string(FLAGS_replica_id_field) + ", " +
+                     std::to_string(FLAGS_replica_offset) + ", " +
+                     std::to_string(FLAGS_replica_jitter) + ")",
+                 [](auto &t) {
+                   t.setReplicas(FLAGS_replicas, FLAGS_replica_id_field,
+                                 FLAGS_replica_offset, FLAGS_replica_jitter);
+                 });
     }
   }
 
@@ -89,25 +265,86 @@ int main(int argc, char **argv) {
     std::istringstream iss(FLAGS_input);
     std::string input;
     while (std::getline(iss, input, ',')) {
-      if (input == "countdown")
-        cmds += "t.createCountDownInput(5, 200)\n"
-                "t.createCountDownInput(2, 300)\n";
-      else {
+      if (input == "countdown") {
+        cmds.add("t.createCountDownInput(5, 200)",
+                 [](auto &t) { t.createCountDownInput(5, 200); });
+        cmds.add("t.createCountDownInput(2, 300)",
+                 [](auto &t) { t.createCountDownInput(2, 300); });
+      } else {
         std::cerr << "Unknown input: " << input << "\n";
         exit(1);
       }
     }
   }
 
-  cmds += "t.run(" + std::to_string(FLAGS_scale) + ")\n";
+  if (!FLAGS_rate.empty()) { // Deal with the rate flag.
+    std::istringstream iss(FLAGS_rate);
+    std::string point;
+    std::vector<std::pair<double, double>> profile;
+    std::string line = "t.setRateProfile([";
+    while (std::getline(iss, point, ',')) {
+      auto colon = point.find(':');
+      std::string secs =
+          colon == std::string::npos ? "0" : point.substr(0, colon);
+      std::string eps =
+          colon == std::string::npos ? point : point.substr(colon + 1);
+      try {
+        profile.emplace_back(std::stod(secs), std::stod(eps));
+      } catch (const std::exception &) {
+        std::cerr << "Bad rate point: " << point << "\n";
+        exit(1);
+      }
+      line += "(" + std::to_string(profile.back().first) + ", " +
+              std::to_string(profile.back().second) + "), ";
+    }
+    line += "])";
+    cmds.add(line, [profile](auto &t) { t.setRateProfile(profile); });
+  }
+
+  if (FLAGS_max_gap > 0)
+    cmds.add("t.setMaxGap(" + std::to_string(FLAGS_max_gap) + ")",
+             [](auto &t) { t.setMaxGap(FLAGS_max_gap); });
+
+  if (FLAGS_loop != 1)
+    cmds.add("t.setLoop(" + std::to_string(FLAGS_loop) + ", " +
+                 std::to_string(FLAGS_loop_gap) + ")",
+             [](auto &t) { t.setLoop(FLAGS_loop, FLAGS_loop_gap); });
+
+  if (FLAGS_partition_count > 1)
+    cmds.add("t.setPartition(" + std::to_string(FLAGS_partition_rank) + ", " +
+                 std::to_string(FLAGS_partition_count) + ", '" +
+                 FLAGS_rendezvous + "', '" + FLAGS_run_id + "')",
+             [](auto &t) {
+               t.setPartition(FLAGS_partition_rank, FLAGS_partition_count,
+                              FLAGS_rendezvous, FLAGS_run_id);
+             });
+
+  if (!FLAGS_inject_socket.empty())
+    cmds.add("t.enableInjection('" + FLAGS_inject_socket + "')",
+             [](auto &t) { t.enableInjection(FLAGS_inject_socket); });
+
+  if (!FLAGS_stats_file.empty())
+    cmds.add("t.setStatsFile('" + FLAGS_stats_file + "')",
+             [](auto &t) { t.setStatsFile(FLAGS_stats_file); });
+
+  if (!FLAGS_trace_file.empty())
+    cmds.add("t.setTraceFile('" + FLAGS_trace_file + "')",
+             [](auto &t) { t.setTraceFile(FLAGS_trace_file); });
+
   if (FLAGS_print) {
-    std::cout << cmds;
+    std::cout << cmds.python << "t.run(" << std::to_string(FLAGS_scale)
+              << ")\n";
     goto out;
   }
 
-  if (gflags::GetCommandLineFlagInfoOrDie("script").is_default)
-    TurboEvents::TurboEvents::runString(cmds);
-  else
+  if (gflags::GetCommandLineFlagInfoOrDie("script").is_default) {
+    // Configure directly through the C++ API, the Python interpreter is
+    // only started for scripts.
+    auto t = TurboEvents::TurboEvents::create(FLAGS_separator[0],
+                                              FLAGS_timeshift);
+    for (auto &step : cmds.steps) step(*t);
+    t->run(FLAGS_scale);
+  } else
     TurboEvents::TurboEvents::runScript(FLAGS_script);
 
 out:
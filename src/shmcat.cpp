@@ -0,0 +1,42 @@
+#include "turboevents-shm.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Print the events of a shared-memory ring until the producer finishes.
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <shm name>\n";
+    return 1;
+  }
+
+  // The producer may not have created the ring yet, give it a moment.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  std::unique_ptr<TurboEvents::Shm::RingReader> r;
+  for (;;) {
+    r = std::make_unique<TurboEvents::Shm::RingReader>(argv[1]);
+    if (r->attached()) break;
+    if (std::chrono::steady_clock::now() > deadline) {
+      std::cerr << "Could not attach to " << argv[1] << "\n";
+      return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  using Status = TurboEvents::Shm::RingReader::Status;
+  TurboEvents::Shm::Message m;
+  for (;;) {
+    Status s = r->poll(m);
+    if (s == Status::Closed) break;
+    if (s == Status::Empty)
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    if (s != Status::Ok) continue;
+    std::string data(m.data);
+    if (r->valid(m)) std::cout << data << "\n";
+  }
+  if (r->lost() > 0) std::cerr << r->lost() << " event(s) were lost\n";
+  return 0;
+}
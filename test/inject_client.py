@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+"""Inject an event on the injection socket of a running generator.
+
+Usage: inject_client.py SOCKET MS PAYLOAD
+
+Waits for the generator to listen on SOCKET, then sends PAYLOAD to be
+emitted MS milliseconds after the generator created SOCKET, which it
+does as the run starts, so the time is relative to the run however long
+either process takes to start.
+"""
+
+import os
+import socket
+import sys
+import time
+
+path, ms, payload = sys.argv[1], int(sys.argv[2]), sys.argv[3]
+deadline = time.time() + 10
+while True:
+    try:
+        s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        s.connect(path)
+        break
+    except OSError:
+        s.close()
+        if time.time() > deadline:
+            sys.exit("No generator listening on " + path)
+        time.sleep(0.005)
+created = os.stat(path).st_mtime_ns // 1000000
+s.sendall(("@%d %s\n" % (created + ms, payload)).encode())
+s.close()
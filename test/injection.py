@@ -0,0 +1,21 @@
+import datetime
+import threading
+import TurboEvents
+t = TurboEvents.TurboEvents(',', False)
+# The countdown events are 200 ms apart in event time from about now.
+start = datetime.datetime.now()
+t.addPrintOutput()
+t.createCountDownInput(5, 200)
+t.enableInjection('')
+
+
+def inject():
+    for i in range(3):
+        time = start + datetime.timedelta(milliseconds=300 + 200 * i)
+        t.injectEvent(time, 'injected,%d' % i)
+
+
+thread = threading.Thread(target=inject)
+thread.start()
+t.run(4.000000)
+thread.join()
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Generate synthetic XML or CSV datasets for the scale tests.
+
+Each of the streams gets events, one per interval seconds, with a
+number of random integer attributes. XML datasets match the xml_ctrl
+returned by xml_ctrl(), CSV datasets have a header row, the time stamp
+in epoch milliseconds in column 0 and the stream key in column 1.
+"""
+
+import argparse
+import datetime
+import random
+
+BASE = datetime.datetime(2022, 1, 12)
+
+
+def xml_ctrl(attributes):
+    """The --xml_ctrl flag for an XML dataset."""
+    names = ":".join("a%d" % i for i in range(attributes))
+    return "patient:id/glucose_level/event:ts:" + names
+
+
+def write_xml(f, streams, events, attributes, interval, rng):
+    f.write('<?xml version="1.0" encoding="UTF-8"?>\n<patients>\n')
+    for s in range(streams):
+        f.write('  <patient id="%d">\n    <glucose_level>\n' % s)
+        t = BASE + datetime.timedelta(seconds=s % interval)
+        for _ in range(events):
+            attrs = "".join(' a%d="%d"' % (i, rng.randrange(1000))
+                            for i in range(attributes))
+            f.write('      <event ts="%s"%s/>\n'
+                    % (t.strftime("%d-%m-%Y %H:%M:%S"), attrs))
+            t += datetime.timedelta(seconds=interval)
+        f.write('    </glucose_level>\n  </patient>\n')
+    f.write('</patients>\n')
+
+
+def write_csv(f, streams, events, attributes, interval, rng):
+    f.write(",".join(["ts", "id"] + ["a%d" % i for i in range(attributes)]))
+    f.write("\n")
+    base = int(BASE.timestamp() * 1000)
+    step = interval * 1000
+    # Rows are in time order, the streams interleaved.
+    for e in range(events):
+        for s in range(streams):
+            ts = base + e * step + (s * step) // streams
+            attrs = ",".join(str(rng.randrange(1000))
+                             for _ in range(attributes))
+            f.write("%d,%d,%s\n" % (ts, s, attrs))
+
+
+def generate(path, fmt, streams, events, attributes, interval=1, seed=0):
+    """Write a dataset to path."""
+    rng = random.Random(seed)
+    write = write_xml if fmt == "xml" else write_csv
+    with open(path, "w") as f:
+        write(f, streams, events, attributes, interval, rng)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("output", help="file to write")
+    parser.add_argument("--format", choices=["xml", "csv"], default="xml")
+    parser.add_argument("--streams", type=int, default=100)
+    parser.add_argument("--events", type=int, default=1000,
+                        help="events per stream")
+    parser.add_argument("--attributes", type=int, default=1,
+                        help="attributes per event")
+    parser.add_argument("--interval", type=int, default=1,
+                        help="seconds between the events of a stream")
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+    generate(args.output, args.format, args.streams, args.events,
+             args.attributes, args.interval, args.seed)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""Run the turbo-events binary on synthetic datasets and compare the
+measurements against stored baselines.
+
+The profiles in the baseline file describe a dataset, the output to
+use and, optionally, a rate to pace the run at. Unpaced runs emit as
+fast as possible and measure throughput. For each profile the dataset
+is generated (and cached in the work directory), the binary is run with
+--stats_file, and load time, events per second, peak RSS and, for paced
+runs, p99 lateness are compared with the baseline of the profile. A
+measurement worse than the baseline by more than the tolerance fails the
+run. Use --update on the reference machine to record new baselines.
+
+Times only hold on the machine and build they were recorded on, so
+profiles also have budgets for the heap allocations per event while
+loading and emitting, which do not depend on either. The profile is run
+again with a tenth of the events, and the allocations the extra events
+of the full run take, divided by their number, may not exceed the
+budget. This leaves out fixed costs such as starting up, catches work
+that allocates more per event as well as allocations that grow faster
+than the number of events, and checks the same on any machine, also in
+sanitizer builds. XML profiles only budget emitting, as the allocations
+of the XML parser depend on its version.
+"""
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_dataset  # noqa: E402
+
+# Metrics compared with the baselines, and whether higher is better.
+METRICS = {
+    "load_seconds": False,
+    "events_per_second": True,
+    "peak_rss_kb": False,
+    "lateness_p99_us": False,
+}
+
+# Allocation counts budgeted per event, for profiles with
+# max_allocations_per_event, measured against a run with a tenth of the
+# events.
+ALLOCATION_METRICS = ["load_allocations", "emit_allocations"]
+SHRINK = 10
+
+
+def dataset(workdir, p):
+    """Generate the dataset of profile p unless it is already there."""
+    name = "%s-%d-%d-%d.%s" % (p["format"], p["streams"], p["events"],
+                               p["attributes"], p["format"])
+    path = os.path.join(workdir, name)
+    if not os.path.exists(path):
+        gen_dataset.generate(path + ".tmp", p["format"], p["streams"],
+                             p["events"], p["attributes"])
+        os.replace(path + ".tmp", path)
+    return path
+
+
+def run(binary, workdir, name, p):
+    """Run the binary on the dataset of profile p, return the stats."""
+    stats = os.path.join(workdir, name + ".stats.json")
+    args = [binary, "--timeshift", "--stats_file=" + stats,
+            "--output=" + p["output"]]
+    if p["output"] == "file":
+        args.append("--file_output=" + os.path.join(workdir, name + ".out"))
+    elif p["output"] == "kafka":
+        # Needs librdkafka 1.3 or later.
+        args += ["--kafka_brokers=mock", "--kafka_topic=scale"]
+    if "rate" in p:
+        args.append("--rate=%g" % p["rate"])
+    else:
+        args.append("--scale=0")
+    if p["format"] == "xml":
+        args.append("--xml_ctrl=" + gen_dataset.xml_ctrl(p["attributes"]))
+    else:
+        args += ["--csv_header", "--csv_key_column=1", "--csv_ts_format=ms"]
+    args.append(dataset(workdir, p))
+
+    subprocess.run(args, check=True, stdout=subprocess.DEVNULL)
+    with open(stats) as f:
+        result = json.load(f)
+    expected = p["streams"] * p["events"]
+    if result["events"] != expected:
+        raise RuntimeError("%s: emitted %d events, expected %d"
+                           % (name, result["events"], expected))
+    return result
+
+
+def best(results):
+    """Combine repeated runs, keeping the best value of each metric."""
+    combined = dict(results[0])
+    for metric, higher in METRICS.items():
+        values = [r[metric] for r in results]
+        combined[metric] = max(values) if higher else min(values)
+    return combined
+
+
+def allocations_per_event(result, small):
+    """Allocations per event of the events the full run has in addition
+    to the small one, per metric."""
+    extra = result["events"] - small["events"]
+    return {m: (result[m] - small[m]) / extra for m in ALLOCATION_METRICS}
+
+
+def check_allocations(name, budget, per_event):
+    """Print the allocations per event against the budget, return False
+    if any exceeds it."""
+    ok = True
+    for metric, limit in budget.items():
+        bad = per_event[metric] > limit
+        print("%-12s %-18s %12.6g  per event, budget %-8g %s"
+              % (name, metric, per_event[metric], limit,
+                 "REGRESSED" if bad else "ok"))
+        ok = ok and not bad
+    return ok
+
+
+def compare(name, p, result, tolerance):
+    """Print the result against the baseline, return False on regression."""
+    ok = True
+    baseline = p.get("baseline", {})
+    for metric, higher in METRICS.items():
+        if metric == "lateness_p99_us" and "rate" not in p:
+            continue
+        value = result[metric]
+        line = "%-12s %-18s %12.6g" % (name, metric, value)
+        if metric in baseline:
+            base = baseline[metric]
+            if higher:
+                bad = value < base * (1 - tolerance)
+            else:
+                bad = value > base * (1 + tolerance)
+            line += "  baseline %12.6g  %s" % (base, "REGRESSED" if bad
+                                               else "ok")
+            ok = ok and not bad
+        else:
+            line += "  no baseline"
+        print(line)
+    return ok
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--binary", required=True,
+                        help="the turboevents_main binary")
+    parser.add_argument("--baseline", default=os.path.join(here,
+                                                           "baseline.json"))
+    parser.add_argument("--profile", action="append",
+                        help="profile to run, default all")
+    parser.add_argument("--workdir", default=".")
+    parser.add_argument("--repeat", type=int, default=1,
+                        help="runs per profile, the best result counts")
+    parser.add_argument("--tolerance", type=float,
+                        help="allowed relative regression, overrides the "
+                        "baseline file")
+    parser.add_argument("--update", action="store_true",
+                        help="record the results as the new baselines and "
+                        "allocation budgets")
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        config = json.load(f)
+    profiles = config["profiles"]
+    names = args.profile or list(profiles)
+    tolerance = (args.tolerance if args.tolerance is not None
+                 else config.get("tolerance", 0.5))
+    os.makedirs(args.workdir, exist_ok=True)
+
+    ok = True
+    for name in names:
+        if name not in profiles:
+            sys.exit("Unknown profile: " + name)
+        p = profiles[name]
+        result = best([run(args.binary, args.workdir, name, p)
+                       for _ in range(args.repeat)])
+        if args.update:
+            p["baseline"] = {m: result[m] for m in METRICS}
+        ok = compare(name, p, result, tolerance) and ok
+        if "max_allocations_per_event" in p:
+            small = run(args.binary, args.workdir, name + "-small",
+                        dict(p, events=p["events"] // SHRINK))
+            per_event = allocations_per_event(result, small)
+            budget = p["max_allocations_per_event"]
+            if args.update:
+                # Round up, the counts vary a little with buffer growth.
+                for m in budget:
+                    budget[m] = math.ceil(per_event[m] * 100 + 1) / 100
+            ok = check_allocations(name, budget, per_event) and ok
+
+    if args.update:
+        with open(args.baseline, "w") as f:
+            json.dump(config, f, indent=2)
+            f.write("\n")
+    sys.exit(0 if ok or args.update else 1)
+
+
+if __name__ == "__main__":
+    main()
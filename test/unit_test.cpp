@@ -0,0 +1,119 @@
+// Tests of internals that the command line does not show, run as
+// "turboevents_unit_test <test>" by ctest.
+
+#include "IO/CoroutineInput.hpp"
+#include "turboevents-internal.hpp"
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+using namespace TurboEvents;
+
+/// Number of failed checks.
+static int failures = 0;
+
+/// Report cond as a failure unless it holds.
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " #cond "\n";     \
+      ++failures;                                                              \
+    }                                                                          \
+  } while (0)
+
+/// A context as short as that of a glucose reading is shared, also when
+/// the time stamp is rewritten, a tiny one is copied, and both give the
+/// same payload.
+static void sharedEventTest() {
+  Config cfg(',', std::chrono::system_clock::now(), false);
+  auto ctx = std::make_shared<const std::string>(",glucose_level,0");
+  auto e = cfg.makeSharedEvent(cfg.start, "12-01-2022 09:38:00,100", ctx, 19);
+  CHECK(dynamic_cast<SharedPartEvent *>(e.get()) != nullptr);
+  CHECK(e->payload() == "12-01-2022 09:38:00,glucose_level,0,100");
+  CHECK(e->size() == e->payload().size());
+  auto r = e->copyWithPrefix(cfg.start, 19, "2022");
+  CHECK(dynamic_cast<SharedPartEvent *>(r.get()) != nullptr);
+  CHECK(r->payload() == "2022,glucose_level,0,100");
+
+  auto tiny = std::make_shared<const std::string>(",0");
+  auto t = cfg.makeSharedEvent(cfg.start, "1,2", tiny, 1);
+  CHECK(dynamic_cast<SharedPartEvent *>(t.get()) == nullptr);
+  CHECK(t->payload() == "1,0,2");
+}
+
+/// A frame returned to the pool is reused for the next frame of the same
+/// size class, and frames too large for the pool bypass it.
+static void framePoolTest() {
+  void *a = FramePool::allocate(100);
+  FramePool::deallocate(a, 100);
+  void *b = FramePool::allocate(128);
+  CHECK(b == a);
+  void *c = FramePool::allocate(100);
+  CHECK(c != b);
+  FramePool::deallocate(c, 100);
+  FramePool::deallocate(b, 128);
+  void *big = FramePool::allocate(4096);
+  FramePool::deallocate(big, 4096);
+}
+
+/// Counts its destructions, to see the locals of a coroutine go.
+struct Tracker {
+  int *destroyed; ///< Incremented by the destructor.
+  ~Tracker() { ++*destroyed; }
+};
+
+/// Yield events 0, 1, ... forever, with a tracker in the frame whose
+/// address is stored in frame.
+static EventGenerator tracked(std::chrono::system_clock::time_point t,
+                              int *destroyed, const void **frame) {
+  Tracker tracker{destroyed};
+  *frame = &tracker;
+  for (int i = 0;; ++i) co_yield std::tuple(t, i);
+}
+
+/// Destroying a generator suspended at a yield destroys the locals of the
+/// coroutine and returns its frame to the pool for the next one, while a
+/// generator that never ran has no locals to destroy.
+static void generatorDestroyTest() {
+  Config cfg(',', std::chrono::system_clock::now(), false);
+  int destroyed = 0;
+  const void *first = nullptr, *second = nullptr;
+  {
+    EventGenerator g = tracked(cfg.start, &destroyed, &first);
+  }
+  CHECK(destroyed == 0);
+  CHECK(first == nullptr);
+  {
+    EventGenerator g = tracked(cfg.start, &destroyed, &first);
+    CHECK(g.next(cfg));
+    CHECK(g.next(cfg));
+    CHECK(g.event()->payload() == "1");
+    CHECK(destroyed == 0);
+  }
+  CHECK(destroyed == 1);
+  {
+    EventGenerator g = tracked(cfg.start, &destroyed, &second);
+    CHECK(g.next(cfg));
+    CHECK(g.event()->payload() == "0");
+  }
+  CHECK(destroyed == 2);
+  CHECK(second == first);
+}
+
+int main(int argc, char **argv) {
+  const std::map<std::string, void (*)()> tests = {
+      {"shared_event", sharedEventTest},
+      {"frame_pool", framePoolTest},
+      {"generator_destroy", generatorDestroyTest},
+  };
+  if (argc != 2 || !tests.count(argv[1])) {
+    std::cerr << "usage: " << argv[0] << " <test>\n";
+    return 1;
+  }
+  tests.at(argv[1])();
+  if (failures > 0) return 1;
+  std::cout << argv[1] << " ok\n";
+  return 0;
+}